@@ -79,6 +79,8 @@ void populate_idt() {
   SET_IDT_ENTRY(idt[0x20], &pit_linkage);
   /* vector for keyboard interrupt */
   SET_IDT_ENTRY(idt[0x21], &keyboard_linkage);
+  /* vector for serial (COM1) interrupt */
+  SET_IDT_ENTRY(idt[0x24], &serial_linkage);
   /* vector for rtc interrupt */
   SET_IDT_ENTRY(idt[0x28], &rtc_linkage);
   /* vector for system call interrupt */
@@ -176,13 +178,6 @@ extern void idt_gp() {
     ;
 }
 
-/* idt_pf() - Page Fault. Vector 14 (0x0E). */
-extern void idt_pf() {
-  printf("Page Fault, (Vec 0x0E) \n");
-  while (1)
-    ;
-}
-
 /* idt_mf() - Math Fault. Vector 16 (0x10). */
 extern void idt_mf() {
   printf("Math fault, (Vec 0x10) \n");
@@ -57,7 +57,8 @@ extern void idt_ss();
 /* idt_gp() - General Protection. Vector 13 (0x0D). */
 extern void idt_gp();
 
-/* idt_pf() - Page Fault. Vector 14 (0x0E). */
+/* idt_pf() - Page Fault. Vector 14 (0x0E). Assembly linkage in linkage.S
+ * that passes the error code on to handle_page_fault(). */
 extern void idt_pf();
 
 /* idt_mf() - Math Fault. Vector 16 (0x10). */
@@ -7,6 +7,10 @@
 #include "../lib.h"
 #include "paging.h"
 #include "../constants.h"
+#include "../fsys/fs.h"
+#include "../sys/pcb.h"
+#include "../sys/syscall.h"
+#include "../mm/pmm.h"
 
 /* definitions for the flags for page table and directory entires */
 #define GLOBAL              0x00000100
@@ -16,6 +20,10 @@
 #define READ_WRITE          0x00000002
 #define PRESENT             0x00000001
 
+/* definitions for the bits of the page fault error code */
+#define PF_PROTECTION       0x00000001
+#define PF_USER             0x00000004
+
 /* definitions for the beginning of certain segments */
 #define KERNEL_ADDR 0x400000
 #define VIDEO_ADDR  0xB8000
@@ -24,10 +32,13 @@
 #define VIDEO_ADDR3 (VIDEO_ADDR2 + PAGE_4KB)
 #define PROG_VADDR  0x08000000
 
-/* definitions for color, etc in video memory (for initialization) */
-#define NUM_COLS    80
-#define NUM_ROWS    25
-#define ATTRIB      0x7
+/* an unused slot in the shared text page table */
+#define NO_INODE            -1
+
+/* the status a process is halted with when we run out of memory for it */
+#define PF_KILL_STATUS      255
+/* the status a process is halted with when it touches memory it may not */
+#define PF_EXCEPTION_STATUS 256
 
 #define FLAGS1      0x20
 #define FLAGS2      0x40
@@ -36,19 +47,51 @@
 /* definitions for some useful macros for indexing the page directory */
 #define PD_IDX(x) (x >> 22)
 #define PT_IDX(x) ((x >> 12) & 0x03FF)
+#define PAGE_MASK 0xFFFFF000
 
 /* macro to get each terminal's virtual memory pointer */
 #define TERM_VADDR(x) (VIRT_VIDEO_ADDR + (PAGE_4KB * x))
 
-/* static variables to hold certain paging items */
+/* each process's page directory lives in its slot of the kernel window */
+#define PAGE_DIRECTORY(pid) ((page_directory_t*)(PROC_SLOT(pid) + SLOT_PAGE_DIR * PAGE_4KB))
+
+/* static variables to hold certain paging items. page_directory holds the
+ * kernel's mappings, which every process's page directory starts as a copy of */
 static page_directory_t page_directory __attribute__ ((aligned (PAGE_4KB)));
 static page_table_t page_table_1 __attribute__ ((aligned (PAGE_4KB)));
 static page_table_t page_table_2 __attribute__ ((aligned (PAGE_4KB)));
+static page_table_t kernel_window_tables[KERNEL_WINDOW_TABLES] __attribute__ ((aligned (PAGE_4KB)));
+
+/* each process's program page table lives in its slot of the kernel window */
+#define PROGRAM_TABLE(pid) ((page_table_t*)(PROC_SLOT(pid) + SLOT_PROG_TABLE * PAGE_4KB))
+
+/* and so does the page table of its shared memory window */
+#define SHM_TABLE(pid) ((page_table_t*)(PROC_SLOT(pid) + SLOT_SHM_TABLE * PAGE_4KB))
+
+/**
+ * shared_page_t
+ *
+ * DESCRIPTION: one read-only text page of an executable that every process
+ * running it maps. A page whose refcount drops to 0 keeps its contents so
+ * the next launch of that program can pick it straight back up.
+ */
+typedef struct {
+    int32_t inode;      // executable the page belongs to, NO_INODE if unused
+    uint32_t page;      // the virtual address of the page
+    uint32_t frame;     // the physical frame holding it, 0 if none yet
+    uint32_t refcount;  // how many processes have it mapped
+} shared_page_t;
+
+static shared_page_t shared_pages[MAX_SHARED_PAGES];
+static int shared_victim = 0; // where to start looking for a page to reuse
 
 /* static function declarations */
 static void add_page_dir_entry(void* phys_addr, void* virtual_addr, uint32_t flags);
 static void add_page_table_entry(page_table_t * page_table, void* phys_addr, void* virt_addr, uint32_t flags);
-static void page_flushtlb();
+static void page_invalidate(uint32_t virt_addr);
+static int is_demand_page(uint32_t addr);
+static int map_shared_page(uint32_t page);
+static int reclaim_shared_frame();
 
 /**
  * page_init()
@@ -66,6 +109,15 @@ void page_init()
         page_table_1.page_table_entries[i] = 0;
         page_table_2.page_table_entries[i] = 0;
     }
+    for (i = 0; i < KERNEL_WINDOW_TABLES * MAX_ENTRIES; i++) {
+        kernel_window_tables[i / MAX_ENTRIES].page_table_entries[i % MAX_ENTRIES] = 0;
+    }
+
+    for (i = 0; i < MAX_SHARED_PAGES; i++) {
+        shared_pages[i].inode = NO_INODE;
+        shared_pages[i].frame = PMM_NO_FRAME;
+        shared_pages[i].refcount = 0;
+    }
 
     /* add the first page table (governing pages 0 - 4MB) to the directory */
     uint32_t flags = READ_WRITE | PRESENT;
@@ -75,47 +127,48 @@ void page_init()
     flags = GLOBAL | PAGE_4MB | READ_WRITE | PRESENT;
     add_page_dir_entry((void*)KERNEL_ADDR, (void*)KERNEL_ADDR, flags);
 
+    /* add the (still empty) kernel window page tables. These and all the
+     * other kernel and video mappings are the same in every page directory,
+     * so their pages are global and survive the CR3 load of a switch */
+    flags = READ_WRITE | PRESENT;
+    for (i = 0; i < KERNEL_WINDOW_TABLES; i++) {
+        add_page_dir_entry(&(kernel_window_tables[i]),
+                           (void*)(KERNEL_WINDOW_ADDR + i * FOUR_MB), flags);
+    }
+
     /* create a user-level page table that maps to video memory */
     flags = READ_WRITE | PRESENT | USER_LEVEL| PAGE_CACHE_DISABLE;
     add_page_dir_entry(&(page_table_2), (void*)VIRT_VIDEO_ADDR, flags);
 
-    /* set up the kernel level video memory pages */
-    flags = PAGE_CACHE_DISABLE | READ_WRITE | PRESENT;
+    /* set up the kernel level video memory pages. Each terminal lives in its
+     * own page of VGA text memory for good, the display just gets pointed at
+     * whichever one is visible */
+    flags = GLOBAL | PAGE_CACHE_DISABLE | READ_WRITE | PRESENT;
     add_page_table_entry(&(page_table_1), (void*)VIDEO_ADDR, (void*)VIDEO_ADDR, flags);
-    add_page_table_entry(&(page_table_1), (void*)VIDEO_ADDR, (void*)VIDEO_ADDR1, flags);
+    add_page_table_entry(&(page_table_1), (void*)VIDEO_ADDR1, (void*)VIDEO_ADDR1, flags);
     add_page_table_entry(&(page_table_1), (void*)VIDEO_ADDR2, (void*)VIDEO_ADDR2, flags);
     add_page_table_entry(&(page_table_1), (void*)VIDEO_ADDR3, (void*)VIDEO_ADDR3, flags);
 
-    // set the video memories to be white
-    for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
-        *(uint8_t *)(VIDEO_ADDR1 + (i << 1)) = ' ';
-        *(uint8_t *)(VIDEO_ADDR1 + (i << 1) + 1) = CURSOR1;
-        *(uint8_t *)(VIDEO_ADDR2 + (i << 1)) = ' ';
-        *(uint8_t *)(VIDEO_ADDR2 + (i << 1) + 1) = CURSOR2;
-        *(uint8_t *)(VIDEO_ADDR3 + (i << 1)) = ' ';
-        *(uint8_t *)(VIDEO_ADDR3 + (i << 1) + 1) = CURSOR3;
-    }
-
     /* set user-level vid mem pointers */
-    flags = READ_WRITE | PRESENT | USER_LEVEL| PAGE_CACHE_DISABLE ;
-    add_page_table_entry(&(page_table_2), (void*)VIDEO_ADDR, (void*)TERM_VADDR(0), flags);
+    flags = GLOBAL | READ_WRITE | PRESENT | USER_LEVEL| PAGE_CACHE_DISABLE ;
+    add_page_table_entry(&(page_table_2), (void*)VIDEO_ADDR1, (void*)TERM_VADDR(0), flags);
     add_page_table_entry(&(page_table_2), (void*)VIDEO_ADDR2, (void*)TERM_VADDR(1), flags);
     add_page_table_entry(&(page_table_2), (void*)VIDEO_ADDR3, (void*)TERM_VADDR(2), flags);
 
-    // note that for above we started with terminal 0 (1) pointing to video memory
-
     /* Turn on Paging in assembly. This is done in the following steps: */
     /* 1. Copy the page directory into cr3 */
-    /* 2. Enable PSE (4 MB Pages) */
-    /* 3. Set the paging and protection bits of cr0 */
+    /* 2. Enable PSE (4 MB Pages) and PGE (global pages) */
+    /* 3. Set the paging, protection and write protect bits of cr0. Without
+     *    WP the kernel would write straight through read-only pages, such
+     *    as the shared text of a program it copies syscall results into */
     asm volatile (
         "movl %0, %%eax;"
         "movl %%eax, %%cr3;"
         "movl %%cr4, %%eax;"
-        "orl $0x00000010, %%eax;"
+        "orl $0x00000090, %%eax;"
         "movl %%eax, %%cr4;"
         "movl %%cr0, %%eax;"
-        "orl $0x80000001, %%eax;"
+        "orl $0x80010001, %%eax;"
         "movl %%eax, %%cr0;"
         :
         : "g" (&page_directory)
@@ -124,89 +177,374 @@ void page_init()
 }
 
 /**
- * add_program_page()
+ * setup_program_page()
  *
- * DESCRIPTION: adds or removes a 4 MB page to our page directory for a program
- * (shell or executed by shell) Maps to 128 MB
- * INPUTS: phys_addr - pointer to the physical address to be mapped
- *         adding - 1 if we want to add the page, 0 if we want to remove
+ * DESCRIPTION: prepares the page directory of a process. It starts out as a
+ * copy of the kernel's, plus the page table for the 4 MB program region at
+ * 128 MB. Every 4 KB page of that starts out not present. The page fault
+ * handler gives it a frame and fills it from the program's file the first
+ * time it is touched.
+ * INPUTS: pid - the process the page directory belongs to
  * OUTPUTS: none
  */
-void add_program_page(void* phys_addr, int adding) {
-    uint32_t flags = USER_LEVEL | PAGE_4MB | READ_WRITE;
-    if (adding) {
-        // we are adding the page, so set it to present
-        flags = flags | PRESENT;
+void setup_program_page(int pid) {
+    if (pid < 0 || pid >= MAX_PROCS)
+        return;
+
+    page_directory_t* dir = PAGE_DIRECTORY(pid);
+    int i;
+    for (i = 0; i < MAX_ENTRIES; i++) {
+        PROGRAM_TABLE(pid)->page_table_entries[i] = 0;
+        SHM_TABLE(pid)->page_table_entries[i] = 0;
+        dir->page_directory_entries[i] = page_directory.page_directory_entries[i];
     }
 
-    // call our static helper function to allocate the page dir entry
-    add_page_dir_entry(phys_addr, (void*) PROG_VADDR, flags);
+    uint32_t table = kernel_page_phys((uint32_t)PROGRAM_TABLE(pid));
+    dir->page_directory_entries[PD_IDX(PROG_VADDR)] =
+        table | USER_LEVEL | READ_WRITE | PRESENT;
 
-    page_flushtlb(); // flush the tlb
+    // the shared memory window starts out empty, shm_map fills it in
+    table = kernel_page_phys((uint32_t)SHM_TABLE(pid));
+    dir->page_directory_entries[PD_IDX(SHM_VADDR)] =
+        table | USER_LEVEL | READ_WRITE | PRESENT;
 }
 
 /**
- * switch_video_page()
+ * switch_page_directory()
  *
- * DESCRIPTION: switches the kernel's video memory page to be pointing to the
- *              specified terminal's physical video memory.
- * INPUTS: term_to - the terminal number to switch to (0-2)
- *         term_from - the terminal number switching from
- * OUTPUTS: 0 if successful, -1 otherwise
+ * DESCRIPTION: loads the page directory of a process (the kernel's for the
+ * root pcb, pid -1). Only the non-global program pages leave the TLB.
+ * INPUTS: pid - the process whose address space we are switching to
+ * OUTPUTS: none
  */
-int switch_video_page(int term_to, int term_from) {
-    // quick return if we don't need to do anything
-    if (term_to == term_from)
-        return 0; // technically a success
-
-    // figure out which terminal we are switching to
-    uint32_t to_vaddr;
-    if (term_to == FIRST_TERM) {
-        to_vaddr = VIDEO_ADDR1;
-    } else if (term_to == SECOND_TERM) {
-        to_vaddr = VIDEO_ADDR2;
-    } else if (term_to == THIRD_TERM) {
-        to_vaddr = VIDEO_ADDR3;
+void switch_page_directory(int pid) {
+    uint32_t dir;
+    if (pid < 0 || pid >= MAX_PROCS) {
+        dir = (uint32_t)&page_directory;
     } else {
+        dir = kernel_page_phys((uint32_t)PAGE_DIRECTORY(pid));
+    }
+
+    asm volatile ("movl %0, %%cr3" : : "r" (dir) : "memory");
+}
+
+/**
+ * map_kernel_page()
+ *
+ * DESCRIPTION: backs a page of the kernel window with a fresh frame, unless it
+ * is already backed.
+ * INPUTS: virt_addr - an address in the page to map
+ * OUTPUTS: 0 if the page is mapped, -1 if out of memory or outside the window
+ */
+int map_kernel_page(uint32_t virt_addr) {
+    if (virt_addr < KERNEL_WINDOW_ADDR || virt_addr >= KERNEL_WINDOW_END)
         return -1;
+
+    uint32_t idx = (virt_addr - KERNEL_WINDOW_ADDR) / PAGE_4KB;
+    int* entry = &(kernel_window_tables[idx / MAX_ENTRIES].page_table_entries[idx % MAX_ENTRIES]);
+    if (*entry & PRESENT)
+        return 0;
+
+    uint32_t frame = pmm_alloc_frame();
+    if (frame == PMM_NO_FRAME)
+        return -1;
+
+    *entry = frame | GLOBAL | READ_WRITE | PRESENT;
+    page_invalidate(virt_addr & PAGE_MASK);
+    return 0;
+}
+
+/**
+ * kernel_page_phys()
+ *
+ * DESCRIPTION: looks up the frame backing a page of the kernel window.
+ * INPUTS: virt_addr - an address in the page
+ * OUTPUTS: the physical address of the page, 0 if it is not mapped
+ */
+uint32_t kernel_page_phys(uint32_t virt_addr) {
+    if (virt_addr < KERNEL_WINDOW_ADDR || virt_addr >= KERNEL_WINDOW_END)
+        return 0;
+
+    uint32_t idx = (virt_addr - KERNEL_WINDOW_ADDR) / PAGE_4KB;
+    uint32_t entry = kernel_window_tables[idx / MAX_ENTRIES].page_table_entries[idx % MAX_ENTRIES];
+    if (!(entry & PRESENT))
+        return 0;
+    return (entry & PAGE_MASK) | (virt_addr & ~PAGE_MASK);
+}
+
+/**
+ * handle_page_fault()
+ *
+ * DESCRIPTION: called by the page fault linkage. Fills in not-present pages of
+ * the current program from its executable. Any other fault the program caused
+ * kills it with status 256, anything else is a real fault.
+ * INPUTS: error_code - the error code the processor pushed for the fault
+ * OUTPUTS: none
+ */
+void handle_page_fault(uint32_t error_code) {
+    uint32_t fault_addr;
+    asm volatile ("movl %%cr2, %0" : "=r" (fault_addr));
+
+    // faults that are not the process's (itself, or a system call touching
+    // its program region) are kernel bugs
+    if (curr_pcb->pid < 0 || (!(error_code & PF_USER) &&
+        (fault_addr < PROG_VADDR || fault_addr >= PROG_VADDR + FOUR_MB))) {
+        printf("Page Fault at 0x%#x, error 0x%x (Vec 0x0E) \n", fault_addr, error_code);
+        while (1)
+            ;
     }
 
-    // figure out which terminal we are switching from
-    uint32_t from_vaddr;
-    if (term_from == FIRST_TERM) {
-        from_vaddr = VIDEO_ADDR1;
-    } else if (term_from == SECOND_TERM) {
-        from_vaddr = VIDEO_ADDR2;
-    } else if (term_from == THIRD_TERM) {
-        from_vaddr = VIDEO_ADDR3;
-    } else {
+    // a process writing to its read-only text or touching a page it never
+    // asked for is killed, not the whole kernel
+    if ((error_code & PF_PROTECTION) || !is_demand_page(fault_addr)) {
+        printf("Page Fault at 0x%#x, killing process %d\n", fault_addr, curr_pcb->pid);
+        halt_process(PF_EXCEPTION_STATUS);
+    }
+
+    uint32_t page = fault_addr & PAGE_MASK;
+    int pt_idx = PT_IDX(fault_addr);
+
+    // text pages come from the shared frames if we can get one
+    if (page >= curr_pcb->text_start && page < curr_pcb->text_end &&
+        map_shared_page(page) == 0) {
+        return;
+    }
+
+    uint32_t frame = pmm_alloc_frame();
+    if (frame == PMM_NO_FRAME && reclaim_shared_frame() == 0)
+        frame = pmm_alloc_frame();
+    if (frame == PMM_NO_FRAME) {
+        // nothing left to give this process, so it has to go
+        printf("Out of memory at 0x%#x, killing process %d\n", fault_addr, curr_pcb->pid);
+        system_halt(PF_KILL_STATUS);
+    }
+
+    PROGRAM_TABLE(curr_pcb->pid)->page_table_entries[pt_idx] =
+        frame | USER_LEVEL | READ_WRITE | PRESENT;
+    page_invalidate(page);
+
+    // the frame may hold an old program's data, so clear it before filling
+    // in the part of the executable (if any) that lives in this page. The
+    // executable is laid out flat starting at EXEC_ADDR.
+    memset((void*)page, 0, PAGE_4KB);
+    if (page >= EXEC_ADDR) {
+        read_data(curr_pcb->exec_inode, page - EXEC_ADDR, (uint8_t*)page, PAGE_4KB);
+    }
+}
+
+/**
+ * is_demand_page()
+ *
+ * DESCRIPTION: tells whether an address of the current program may be faulted
+ * in: the ring page, the executable image, the heap up to the page holding
+ * brk, and the stack above HEAP_LIMIT.
+ * INPUTS: addr - the address that faulted
+ * OUTPUTS: 1 if the page is demand loaded, 0 otherwise
+ */
+static int is_demand_page(uint32_t addr) {
+    uint32_t brk_page = (curr_pcb->brk + PAGE_4KB - 1) & PAGE_MASK;
+
+    if (addr >= RING_ADDR && addr < RING_ADDR + sizeof(io_ring_t))
+        return 1;
+    if (addr >= EXEC_ADDR && addr < brk_page)
+        return 1; // the image runs straight into the heap at heap_start
+    return addr >= HEAP_LIMIT && addr < PROG_VADDR + FOUR_MB;
+}
+
+/**
+ * map_shared_page()
+ *
+ * DESCRIPTION: maps the shared read-only frame for a text page of the current
+ * program, loading it from the executable if no other process has it.
+ * INPUTS: page - the page aligned virtual address that faulted
+ * OUTPUTS: 0 if the page was mapped, -1 if there was no frame to use
+ */
+static int map_shared_page(uint32_t page) {
+    uint32_t flags;
+    int32_t inode = curr_pcb->exec_inode;
+    int pt_idx = PT_IDX(page);
+    int i, slot = -1;
+
+    cli_and_save(flags);
+
+    // see if somebody (now or earlier) already loaded this page
+    for (i = 0; i < MAX_SHARED_PAGES; i++) {
+        if (shared_pages[i].inode == inode && shared_pages[i].page == page) {
+            shared_pages[i].refcount++;
+            PROGRAM_TABLE(curr_pcb->pid)->page_table_entries[pt_idx] =
+                shared_pages[i].frame | USER_LEVEL | PRESENT;
+            page_invalidate(page);
+            restore_flags(flags);
+            return 0;
+        }
+    }
+
+    // otherwise take an unused slot, or one nobody is mapping anymore
+    for (i = 0; i < MAX_SHARED_PAGES; i++) {
+        int idx = (shared_victim + i) % MAX_SHARED_PAGES;
+        if (shared_pages[idx].refcount == 0) {
+            slot = idx;
+            if (shared_pages[idx].inode == NO_INODE)
+                break;
+        }
+    }
+
+    if (slot < 0) {
+        restore_flags(flags);
         return -1;
     }
 
-    cli();
-    // map the virtual memory addresses of the previous terminal to their own video memory
-    uint32_t flags = PAGE_CACHE_DISABLE | READ_WRITE | PRESENT; // kernel level
-    add_page_table_entry(&(page_table_1), (void*)from_vaddr, (void*)from_vaddr, flags);
+    // a slot that was never used (or was reclaimed) still needs a frame
+    if (shared_pages[slot].frame == PMM_NO_FRAME) {
+        shared_pages[slot].frame = pmm_alloc_frame();
+        if (shared_pages[slot].frame == PMM_NO_FRAME) {
+            restore_flags(flags);
+            return -1;
+        }
+    }
+    shared_victim = (slot + 1) % MAX_SHARED_PAGES;
+
+    shared_pages[slot].inode = inode;
+    shared_pages[slot].page = page;
+    shared_pages[slot].refcount = 1;
+
+    // fill it through a writable mapping, then take write access away
+    PROGRAM_TABLE(curr_pcb->pid)->page_table_entries[pt_idx] =
+        shared_pages[slot].frame | USER_LEVEL | READ_WRITE | PRESENT;
+    page_invalidate(page);
+    memset((void*)page, 0, PAGE_4KB);
+    read_data(inode, page - EXEC_ADDR, (uint8_t*)page, PAGE_4KB);
+
+    PROGRAM_TABLE(curr_pcb->pid)->page_table_entries[pt_idx] =
+        shared_pages[slot].frame | USER_LEVEL | PRESENT;
+    page_invalidate(page);
+
+    restore_flags(flags);
+    return 0;
+}
+
+/**
+ * reclaim_shared_frame()
+ *
+ * DESCRIPTION: gives the frame of one cached shared page that nobody has
+ * mapped back to the frame allocator.
+ * INPUTS: none
+ * OUTPUTS: 0 if a frame was freed, -1 if every cached page is in use
+ */
+static int reclaim_shared_frame() {
+    uint32_t flags;
+    int i;
+
+    cli_and_save(flags);
+    for (i = 0; i < MAX_SHARED_PAGES; i++) {
+        if (shared_pages[i].refcount == 0 && shared_pages[i].frame != PMM_NO_FRAME) {
+            pmm_free_frame(shared_pages[i].frame);
+            shared_pages[i].frame = PMM_NO_FRAME;
+            shared_pages[i].inode = NO_INODE;
+            restore_flags(flags);
+            return 0;
+        }
+    }
+    restore_flags(flags);
+    return -1;
+}
+
+/**
+ * release_program_pages()
+ *
+ * DESCRIPTION: frees the private frames of a halting process and drops its
+ * references to shared text pages.
+ * INPUTS: pid - the process that is going away
+ * OUTPUTS: none
+ */
+void release_program_pages(int pid) {
+    release_program_range(pid, PROG_VADDR, PROG_VADDR + FOUR_MB);
+}
 
-    flags = READ_WRITE | PRESENT | USER_LEVEL| PAGE_CACHE_DISABLE; // user level
-    add_page_table_entry(&(page_table_2), (void*)from_vaddr, (void*)TERM_VADDR(term_from), flags);
+/**
+ * release_program_range()
+ *
+ * DESCRIPTION: unmaps the pages of a process's program region that lie in
+ * [start, end), freeing its private frames and dropping its references to
+ * shared text pages. The pages fault back in empty if they are touched again.
+ * INPUTS: pid - the process
+ *         start - the first page aligned address to unmap
+ *         end - the page aligned address just past the range
+ * OUTPUTS: none
+ */
+void release_program_range(int pid, uint32_t start, uint32_t end) {
+    if (pid < 0 || pid >= MAX_PROCS || start < PROG_VADDR || end > PROG_VADDR + FOUR_MB)
+        return;
 
-    page_flushtlb();
+    uint32_t flags;
+    uint32_t page;
+    int j;
+    cli_and_save(flags);
+    for (page = start; page < end; page += PAGE_4KB) {
+        int i = PT_IDX(page);
+        uint32_t entry = PROGRAM_TABLE(pid)->page_table_entries[i];
+        uint32_t frame = entry & PAGE_MASK;
+        if (!(entry & PRESENT))
+            continue;
+        PROGRAM_TABLE(pid)->page_table_entries[i] = 0;
+        page_invalidate(page);
+
+        // private pages are the only writable ones
+        if (entry & READ_WRITE) {
+            pmm_free_frame(frame);
+            continue;
+        }
+
+        for (j = 0; j < MAX_SHARED_PAGES; j++) {
+            if (shared_pages[j].frame == frame) {
+                if (shared_pages[j].refcount > 0)
+                    shared_pages[j].refcount--;
+                break;
+            }
+        }
+    }
+    restore_flags(flags);
+}
 
-    // copy the data to and from physical video memory
-    memcpy((void*)from_vaddr, (void*)VIDEO_ADDR, PAGE_4KB);
-    memcpy((void*)VIDEO_ADDR, (void*)to_vaddr, PAGE_4KB);
+/**
+ * map_shm_page()
+ *
+ * DESCRIPTION: maps a frame of a shared memory segment into a process's shared
+ * memory window, writable from user space.
+ * INPUTS: pid - the process
+ *         virt_addr - the page aligned address in the window
+ *         frame - the physical frame
+ * OUTPUTS: 0 if successful, -1 if the address is outside the window
+ */
+int map_shm_page(int pid, uint32_t virt_addr, uint32_t frame) {
+    if (pid < 0 || pid >= MAX_PROCS || virt_addr < SHM_VADDR || virt_addr >= SHM_VADDR + FOUR_MB)
+        return -1;
 
-    // map the virtual video memory addresses to point to physical video memory
-    flags = PAGE_CACHE_DISABLE | READ_WRITE | PRESENT; // kernel level
-    add_page_table_entry(&(page_table_1), (void*)VIDEO_ADDR, (void*)to_vaddr, flags);
+    SHM_TABLE(pid)->page_table_entries[PT_IDX(virt_addr)] =
+        (frame & PAGE_MASK) | USER_LEVEL | READ_WRITE | PRESENT;
+    page_invalidate(virt_addr & PAGE_MASK);
+    return 0;
+}
 
-    flags = READ_WRITE | PRESENT | USER_LEVEL| PAGE_CACHE_DISABLE; // user level
-    add_page_table_entry(&(page_table_2), (void*)VIDEO_ADDR, (void*)TERM_VADDR(term_to), flags);
+/**
+ * unmap_shm_range()
+ *
+ * DESCRIPTION: unmaps the pages of a process's shared memory window that lie
+ * in [start, end). The frames belong to the segment and are not freed.
+ * INPUTS: pid - the process
+ *         start - the first page aligned address to unmap
+ *         end - the page aligned address just past the range
+ * OUTPUTS: none
+ */
+void unmap_shm_range(int pid, uint32_t start, uint32_t end) {
+    if (pid < 0 || pid >= MAX_PROCS || start < SHM_VADDR || end > SHM_VADDR + FOUR_MB)
+        return;
 
-    page_flushtlb(); // flush the tlb
-    sti();
-    return 0; // success
+    uint32_t page;
+    for (page = start; page < end; page += PAGE_4KB) {
+        SHM_TABLE(pid)->page_table_entries[PT_IDX(page)] = 0;
+        page_invalidate(page);
+    }
 }
 
 /**
@@ -226,16 +564,13 @@ uint8_t* request_user_video(int term_index) {
 }
 
 /**
- * page_flushtlb()
+ * page_invalidate()
  *
- * DESCRIPTION: flushes the TLB. Necessary when changes made to paging
+ * DESCRIPTION: drops the TLB entry for a single page
+ * INPUTS: virt_addr - an address in the page to drop
  */
-static void page_flushtlb() {
-    /* according to wiki.osdev.org/TLB, we can flush the TLB by simply writing
-       to the PDBR (CR3) */
-    asm volatile ("movl %%cr3, %%eax;"
-                  "movl %%eax, %%cr3;"
-                  : : : "%eax");
+static void page_invalidate(uint32_t virt_addr) {
+    asm volatile ("invlpg (%0)" : : "r" (virt_addr) : "memory");
 }
 
 /**
@@ -300,7 +635,7 @@ int paging_tester() {
     // define the flags expected for our directory/table values
     uint32_t dir_ent_0_flags = READ_WRITE | PRESENT;
     uint32_t dir_ent_1_flags = GLOBAL | PAGE_4MB | READ_WRITE | PRESENT;
-    uint32_t tab_ent_vid_flags = PAGE_CACHE_DISABLE | READ_WRITE | PRESENT;
+    uint32_t tab_ent_vid_flags = GLOBAL | PAGE_CACHE_DISABLE | READ_WRITE | PRESENT;
 
     // check the directory and table values
     if (page_directory.page_directory_entries[0] != (((int)(&page_table_1)) | dir_ent_0_flags) &&
@@ -18,9 +18,22 @@
 /* definition for alignment at 4KB */
 #define PAGE_4KB 4096
 
+/* how many 4 KB frames are kept for sharing program text */
+#define MAX_SHARED_PAGES 256
+
+/* the kernel window (virtual 8 - 16 MB) is only mapped for the kernel and is
+ * filled in a page at a time with frames from the frame allocator */
+#define KERNEL_WINDOW_ADDR      0x00800000
+#define KERNEL_WINDOW_TABLES    2
+#define KERNEL_WINDOW_END       (KERNEL_WINDOW_ADDR + KERNEL_WINDOW_TABLES * FOUR_MB)
+
 /* definition for certain addresses in virtual memory */
 #define VIRT_VIDEO_ADDR 0x08400000
 
+/* shared memory segments are mapped in the 4 MB right after the vidmap pages,
+ * through a page table of each process's own */
+#define SHM_VADDR       0x08800000
+
 /**
  * page_directory_t
  *
@@ -49,26 +62,100 @@ typedef struct page_table_struct {
 void page_init();
 
 /**
- * add_program_page()
+ * setup_program_page()
+ *
+ * DESCRIPTION: prepares the page directory of a process: a copy of the
+ * kernel's plus an empty (demand loaded) 4 MB program region at 128 MB.
+ * INPUTS: pid - the process the page directory belongs to
+ * OUTPUTS: none
+ */
+void setup_program_page(int pid);
+
+/**
+ * switch_page_directory()
+ *
+ * DESCRIPTION: loads the page directory of a process (the kernel's for the
+ * root pcb, pid -1). Only the non-global program pages leave the TLB.
+ * INPUTS: pid - the process whose address space we are switching to
+ * OUTPUTS: none
+ */
+void switch_page_directory(int pid);
+
+/**
+ * map_kernel_page()
+ *
+ * DESCRIPTION: backs a page of the kernel window with a fresh frame, unless it
+ * is already backed.
+ * INPUTS: virt_addr - an address in the page to map
+ * OUTPUTS: 0 if the page is mapped, -1 if out of memory or outside the window
+ */
+int map_kernel_page(uint32_t virt_addr);
+
+/**
+ * kernel_page_phys()
+ *
+ * DESCRIPTION: looks up the frame backing a page of the kernel window.
+ * INPUTS: virt_addr - an address in the page
+ * OUTPUTS: the physical address of the page, 0 if it is not mapped
+ */
+uint32_t kernel_page_phys(uint32_t virt_addr);
+
+/**
+ * handle_page_fault()
+ *
+ * DESCRIPTION: called by the page fault linkage. Fills in not-present pages of
+ * the current program from its executable, anything else is a real fault.
+ * INPUTS: error_code - the error code the processor pushed for the fault
+ * OUTPUTS: none
+ */
+void handle_page_fault(uint32_t error_code);
+
+/**
+ * release_program_pages()
+ *
+ * DESCRIPTION: frees the private frames of a halting process and drops its
+ * references to shared text pages.
+ * INPUTS: pid - the process that is going away
+ * OUTPUTS: none
+ */
+void release_program_pages(int pid);
+
+/**
+ * release_program_range()
  *
- * DESCRIPTION: adds or removes a 4 MB page to our page directory for a program
- * (shell or executed by shell) Maps to 128 MB
- * INPUTS: phys_addr - pointer to the physical address to be mapped
- *         adding - 1 if we want to add the page, 0 if we want to remove
+ * DESCRIPTION: unmaps the pages of a process's program region that lie in
+ * [start, end), freeing its private frames and dropping its references to
+ * shared text pages.
+ * INPUTS: pid - the process
+ *         start - the first page aligned address to unmap
+ *         end - the page aligned address just past the range
  * OUTPUTS: none
  */
-void add_program_page(void* phys_addr, int adding);
+void release_program_range(int pid, uint32_t start, uint32_t end);
 
 /**
- * switch_video_page()
+ * map_shm_page()
  *
- * DESCRIPTION: switches the kernel's video memory page to be pointing to the
- *              specified terminal's physical video memory.
- * INPUTS: term_to - the terminal number to switch to (0-2)
- *         term_from - the terminal number switching from (0-2)
- * OUTPUTS: 0 if successful, -1 otherwise
+ * DESCRIPTION: maps a frame of a shared memory segment into a process's shared
+ * memory window, writable from user space.
+ * INPUTS: pid - the process
+ *         virt_addr - the page aligned address in the window
+ *         frame - the physical frame
+ * OUTPUTS: 0 if successful, -1 if the address is outside the window
+ */
+int map_shm_page(int pid, uint32_t virt_addr, uint32_t frame);
+
+/**
+ * unmap_shm_range()
+ *
+ * DESCRIPTION: unmaps the pages of a process's shared memory window that lie
+ * in [start, end). The frames belong to the segment and are not freed.
+ * INPUTS: pid - the process
+ *         start - the first page aligned address to unmap
+ *         end - the page aligned address just past the range
+ * OUTPUTS: none
  */
-int switch_video_page(int term_to, int term_from);
+void unmap_shm_range(int pid, uint32_t start, uint32_t end);
 
 /**
  * request_user_video()
@@ -9,6 +9,54 @@
 
 static uint32_t curr_directory = 0;
 
+/* hash index over the dentry names, built once at boot by init_fs() */
+static int16_t dentry_buckets[DENTRY_HASH_BUCKETS];
+static int16_t dentry_chain[MAX_DENTRIES];
+static uint32_t dentry_hashes[MAX_DENTRIES];
+
+/**
+ * dentry_name_hash()
+ *
+ * DESCRIPTION: FNV-1a hash of a file name, stopping at the null character or
+ *              at MAX_DIRNAME_LEN bytes (names are not always null terminated).
+ * INPUTS: name - the name to hash
+ * OUTPUTS: the 32 bit hash of the name
+ */
+static uint32_t dentry_name_hash(const uint8_t* name) {
+  uint32_t hash = 2166136261U; // FNV offset basis
+  int i;
+  for (i = 0; i < MAX_DIRNAME_LEN && name[i] != '\0'; i++) {
+    hash ^= name[i];
+    hash *= 16777619U; // FNV prime
+  }
+  return hash;
+}
+
+void init_fs() {
+  int32_t num_dentries = bootblock->num_dentries;
+  int i;
+
+  for (i = 0; i < DENTRY_HASH_BUCKETS; i++) {
+    dentry_buckets[i] = DENTRY_NONE;
+  }
+
+  // a corrupt count would run past the boot block, so leave the index empty
+  // (read_dentry_by_name fails the same way for it)
+  if (num_dentries > MAX_DENTRIES) {
+    return;
+  }
+
+  // insert backwards so each chain lists dentries in directory order, which
+  // keeps the first-match behavior of the old linear scan
+  for (i = num_dentries - 1; i >= 0; i--) {
+    uint32_t hash = dentry_name_hash(bootblock->dentries[i].file_name);
+    int bucket = hash & (DENTRY_HASH_BUCKETS - 1);
+    dentry_hashes[i] = hash;
+    dentry_chain[i] = dentry_buckets[bucket];
+    dentry_buckets[bucket] = i;
+  }
+}
+
 int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry) {
 
   // Check null pointers
@@ -37,10 +85,13 @@ int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry) {
     fname_len++;
   }
 
-  // loop through all the dentries until we find one with a name that matches
-  int i;
-  for (i = 0; i < num_dentries; i++) {
-    if (!strncmp((int8_t*)(bootblock->dentries[i].file_name), (int8_t*)fname, fname_len)) {
+  // walk the hash chain for this name, only comparing names whose full hash
+  // matches
+  uint32_t hash = dentry_name_hash(fname);
+  int i = dentry_buckets[hash & (DENTRY_HASH_BUCKETS - 1)];
+  while (i != DENTRY_NONE) {
+    if (dentry_hashes[i] == hash &&
+        !strncmp((int8_t*)(bootblock->dentries[i].file_name), (int8_t*)fname, fname_len)) {
       // copy the dentry struct from here into the dentry_t parameter
       // we know the dentry struct is DENTRY_SIZE bytes, so we can just use memcpy
       memcpy(dentry, &(bootblock->dentries[i]), DENTRY_SIZE);
@@ -48,6 +99,7 @@ int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry) {
       // we found and executed the copy, we can just return now
       return 0;
     }
+    i = dentry_chain[i];
   }
 
   // did not find a matching file, return error
@@ -71,15 +123,148 @@ int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry) {
   return 0; // success!
 }
 
-int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length) {
-  int32_t bytes_read = 0;
-  int32_t num_inodes = bootblock->num_inodes;
+/* extent maps, built lazily the first time an inode is read */
+static extent_map_t extent_maps[MAX_MAPPED_INODES];
+static extent_t extent_pool[EXTENT_POOL_SIZE];
+static uint32_t extent_pool_used = 0;
+
+/**
+ * next_extent()
+ *
+ * DESCRIPTION: finds the run of consecutive data blocks that starts at block
+ *              file_block of a file.
+ * INPUTS: file - the inode of the file
+ *         file_block - the block within the file the run starts at
+ *         num_blocks - the number of blocks the file has
+ *         ext - the extent to fill in
+ * OUTPUTS: 0 if successful, -1 if file_block is past the end of the file or
+ *          points at a data block that does not exist
+ */
+static int32_t next_extent(inode_t* file, uint32_t file_block, uint32_t num_blocks, extent_t* ext) {
+  if (file_block >= num_blocks || file->dblocks[file_block] >= bootblock->num_data_blocks) {
+    return -1;
+  }
+
+  ext->file_block = file_block;
+  ext->dblock = file->dblocks[file_block];
+  ext->num_blocks = 1;
+
+  // grow the run for as long as the next block follows the last one on disk
+  while (file_block + ext->num_blocks < num_blocks &&
+         file->dblocks[file_block + ext->num_blocks] == ext->dblock + ext->num_blocks) {
+    ext->num_blocks++;
+  }
+  return 0;
+}
+
+/**
+ * build_extent_map()
+ *
+ * DESCRIPTION: collapses the data blocks of an inode into extents and stores
+ *              them in the extent pool. If the pool is full, the inode is
+ *              marked so that reads coalesce its blocks on the fly instead.
+ * INPUTS: inode - the inode number (less than MAX_MAPPED_INODES)
+ *         file - the inode of the file
+ *         num_blocks - the number of blocks the file has
+ * OUTPUTS: none
+ */
+static void build_extent_map(uint32_t inode, inode_t* file, uint32_t num_blocks) {
+  extent_map_t* map = &extent_maps[inode];
+  uint32_t flags;
+  extent_t ext;
+  uint32_t block = 0;
+
+  // two processes could fault in the same program at once, so build the map
+  // with interrupts off
+  cli_and_save(flags);
+  if (map->state != EXTENTS_UNBUILT) {
+    restore_flags(flags);
+    return;
+  }
+
+  map->first = extent_pool_used;
+  map->count = 0;
+  while (next_extent(file, block, num_blocks, &ext) == 0) {
+    if (extent_pool_used == EXTENT_POOL_SIZE) {
+      // out of room, give back what we took and fall back to the slow path
+      extent_pool_used = map->first;
+      map->state = EXTENTS_UNCACHED;
+      restore_flags(flags);
+      return;
+    }
+    extent_pool[extent_pool_used++] = ext;
+    map->count++;
+    block += ext.num_blocks;
+  }
+  map->state = EXTENTS_BUILT;
+  restore_flags(flags);
+}
 
-  // the starting index, (offset / BLOCK_SIZE, since offset is in bytes)
-  int dblock_index = offset / BLOCK_SIZE;
+/**
+ * find_extent()
+ *
+ * DESCRIPTION: finds the extent of a file that holds block file_block, using
+ *              the inode's extent map when it has one.
+ * INPUTS: inode - the inode number
+ *         file - the inode of the file
+ *         file_block - the block within the file to look for
+ *         ext - the extent to fill in
+ * OUTPUTS: 0 if successful, -1 otherwise
+ */
+static int32_t find_extent(uint32_t inode, inode_t* file, uint32_t file_block, extent_t* ext) {
+  uint32_t num_blocks = (file->length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  if (num_blocks > DBLOCKS_PER_INODE) {
+    num_blocks = DBLOCKS_PER_INODE;
+  }
+
+  if (inode >= MAX_MAPPED_INODES) {
+    return next_extent(file, file_block, num_blocks, ext);
+  }
+
+  if (extent_maps[inode].state == EXTENTS_UNBUILT) {
+    build_extent_map(inode, file, num_blocks);
+  }
+
+  if (extent_maps[inode].state != EXTENTS_BUILT) {
+    return next_extent(file, file_block, num_blocks, ext);
+  }
+
+  // binary search the (sorted) extents for the one containing file_block
+  extent_t* extents = &extent_pool[extent_maps[inode].first];
+  int32_t lo = 0;
+  int32_t hi = extent_maps[inode].count - 1;
+  while (lo <= hi) {
+    int32_t mid = (lo + hi) / 2;
+    if (file_block < extents[mid].file_block) {
+      hi = mid - 1;
+    } else if (file_block >= extents[mid].file_block + extents[mid].num_blocks) {
+      lo = mid + 1;
+    } else {
+      *ext = extents[mid];
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/**
+ * map_data()
+ *
+ * DESCRIPTION: finds where the bytes of file inode starting at offset sit in
+ *              the file system image, as far as the data blocks run on
+ *              consecutively. Lets callers use the data without copying it.
+ * INPUTS: inode - inode number of file to read
+ *         offset - offset of the first byte wanted
+ *         length - the most bytes wanted
+ *         data - where to store the address of the first byte
+ * OUTPUTS: number of bytes at data (0 means EOF), -1 on failure
+ */
+int32_t map_data(uint32_t inode, uint32_t offset, uint32_t length, const uint8_t** data) {
+  int32_t num_inodes = bootblock->num_inodes;
+  extent_t ext;
 
   // Check to make sure we have valid parameters
-  if (inode >= num_inodes || buf == NULL) {
+  if (inode >= num_inodes || data == NULL) {
     return -1;
   }
 
@@ -87,63 +272,51 @@ int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length
   // remember to +1 to the inode index because inodes are zero indexed
   inode_t* src_file = (inode_t*) (bootblock + (inode + 1));
 
-  // get the start dblock location
-  int32_t dblock_ptr = src_file->dblocks[dblock_index];
+  // reading at or past the end of the file is an EOF
+  if (offset >= src_file->length) {
+    return 0;
+  }
 
-  // get the pointer to the starting data block
-  void* curr_dblock = (void*) (bootblock + (num_inodes + 1 + dblock_ptr));
+  // never read past the end of the file
+  if (src_file->length - offset < length) {
+    length = src_file->length - offset;
+  }
 
-  // start the pointer at a location in the data block based on the offset
-  curr_dblock += (offset % BLOCK_SIZE);
+  if (find_extent(inode, src_file, offset / BLOCK_SIZE, &ext) < 0) {
+    return -1; // the inode points at a bad data block
+  }
 
-  // keep track of how far into the file we are, in bytes
-  uint32_t file_remaining = length;
-  if (src_file->length - offset < length) {
-    file_remaining = src_file->length - offset;
-  }
-
-  // first deal with the very first block which has the offset
-  // if file_remaining is more than block - offset, copy the remaining block
-    if (file_remaining > BLOCK_SIZE - (offset % BLOCK_SIZE)) {
-      memcpy(buf, curr_dblock + offset, BLOCK_SIZE - (offset % BLOCK_SIZE));
-      bytes_read += BLOCK_SIZE - (offset % BLOCK_SIZE);
-      file_remaining -= BLOCK_SIZE - (offset % BLOCK_SIZE);
-      // go to next dblock
-      dblock_index++;
-      if (dblock_index < DBLOCKS_PER_INODE)
-        dblock_ptr = src_file->dblocks[dblock_index];
-      curr_dblock = (void*) (bootblock + (num_inodes + 1 + dblock_ptr));
-    } else {
-      // otherwise, copy the remaining file
-      memcpy(buf, curr_dblock, file_remaining);
-      bytes_read += file_remaining;
-      file_remaining -= file_remaining;
-    }
+  // the data blocks start right after the last inode
+  uint8_t* data_blocks = (uint8_t*) (bootblock + (num_inodes + 1));
 
-  // now we can loop until we have no more of the file remaining
-  while (file_remaining > 0) {
+  // stop at the end of the extent
+  uint32_t ext_offset = offset - ext.file_block * BLOCK_SIZE;
+  if (length > ext.num_blocks * BLOCK_SIZE - ext_offset) {
+    length = ext.num_blocks * BLOCK_SIZE - ext_offset;
+  }
 
-    // if file_remaining is greater than this block, copy the whole block
-    if (file_remaining > BLOCK_SIZE) {
-      memcpy(buf + bytes_read, curr_dblock, BLOCK_SIZE);
-      bytes_read += BLOCK_SIZE;
-      file_remaining -= BLOCK_SIZE;
-    } else {
-      // otherwise, copy the remaining file
-      memcpy(buf + bytes_read, curr_dblock, file_remaining);
-      bytes_read += file_remaining;
-      file_remaining -= file_remaining;
-    }
+  *data = data_blocks + ext.dblock * BLOCK_SIZE + ext_offset;
+  return length;
+}
+
+int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length) {
+  uint32_t bytes_read = 0;
+
+  // Check to make sure we have valid parameters
+  if (inode >= bootblock->num_inodes || buf == NULL) {
+    return -1;
+  }
 
-    // check if we're out of range of the curr_dblock
-    if ((bytes_read + offset) % (BLOCK_SIZE) == 0) {
-      // go to next dblock
-      dblock_index++;
-      if (dblock_index < DBLOCKS_PER_INODE)
-        dblock_ptr = src_file->dblocks[dblock_index];
-      curr_dblock = (void*) (bootblock + (num_inodes + 1 + dblock_ptr));
+  // copy one whole extent (or what is left of the read) at a time
+  while (bytes_read < length) {
+    const uint8_t* data;
+    int32_t to_copy = map_data(inode, offset + bytes_read, length - bytes_read, &data);
+    if (to_copy <= 0) {
+      break; // EOF, or a bad data block: return what we have
     }
 
+    memcpy(buf + bytes_read, data, to_copy);
+    bytes_read += to_copy;
   }
 
   return bytes_read;
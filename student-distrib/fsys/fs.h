@@ -14,6 +14,17 @@
 #define MAX_DENTRIES 63
 #define DBLOCKS_PER_INODE 1023
 
+/* Defines for the in-memory dentry name index */
+#define DENTRY_HASH_BUCKETS 128  // must be a power of two
+#define DENTRY_NONE -1           // end of a hash chain / empty bucket
+
+/* Defines for the per-inode extent maps */
+#define MAX_MAPPED_INODES 64     // inodes that can have a cached extent map
+#define EXTENT_POOL_SIZE 2048    // total extents shared by all the maps
+#define EXTENTS_UNBUILT 0        // map is built on the first read of the inode
+#define EXTENTS_BUILT 1
+#define EXTENTS_UNCACHED 2       // no room in the pool, coalesce on every read
+
 /* Defines for file types */
 #define FT_RTC 0
 #define FT_DIR 1
@@ -51,6 +62,32 @@ typedef struct {
   uint8_t reserved[24]; // 24 bytes reserved
 } dentry_t;
 
+/**
+ * extent_t - a run of physically consecutive data blocks in a file.
+ *
+ * This data is: file_block - index of the first block within the file
+ *               dblock - data block number the run starts at
+ *               num_blocks - number of blocks in the run
+ */
+typedef struct {
+  uint32_t file_block;
+  uint32_t dblock;
+  uint32_t num_blocks;
+} extent_t;
+
+/**
+ * extent_map_t - where an inode's extents live in the extent pool.
+ *
+ * This data is: state - one of the EXTENTS_* values
+ *               first - index of the inode's first extent in the pool
+ *               count - number of extents the inode has
+ */
+typedef struct {
+  int32_t state;
+  uint32_t first;
+  uint32_t count;
+} extent_map_t;
+
 /**
  * bootblock_t - a struct that holds the data for the boot block (4KB).
  * 
@@ -71,6 +108,16 @@ typedef struct {
 /* Pointer to the bootblock (the first block in the filesystem) */
 bootblock_t* bootblock;
 
+/**
+ * init_fs()
+ *
+ * DESCRIPTION: Builds the in-memory name index over the dentries in the boot
+ *              block. Must be called once bootblock has been set.
+ * INPUTS: none
+ * OUTPUTS: none
+ */
+void init_fs();
+
 /**
  * read_dentry_by_name()
  * 
@@ -91,11 +138,26 @@ int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry);
  */
 int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry);
 
+/**
+ * map_data()
+ *
+ * DESCRIPTION: finds where the bytes of file inode starting at offset sit in
+ *              the file system image, as far as the data blocks run on
+ *              consecutively. Lets callers use the data without copying it.
+ * INPUTS: inode - inode number of file to read
+ *         offset - offset of the first byte wanted
+ *         length - the most bytes wanted
+ *         data - where to store the address of the first byte
+ * OUTPUTS: number of bytes at data (0 means EOF), -1 on failure
+ */
+int32_t map_data(uint32_t inode, uint32_t offset, uint32_t length, const uint8_t** data);
+
 /**
  * read_data()
  * 
  * DESCRIPTION: reads up to length bytes starting from position offset in file
- *              inode, and puts the data into BUFF.
+ *              inode, and puts the data into BUFF. Runs of consecutive data
+ *              blocks are copied with a single memcpy each.
  * INPUTS: inode - inode number of file to read
  *         offset - offset to start reading at
  *         buf - the buffer to write to
@@ -32,6 +32,7 @@
 #define IRQ_KEYBOARD 	      1
 #define IRQ_RTC             8
 #define IRQ_PIT             0
+#define IRQ_SERIAL          4
 
 /* Externally-visible functions */
 
@@ -11,12 +11,17 @@
 #include "bootinit/idt.h"
 #include "keyboard.h"
 #include "rtc.h"
+#include "serial.h"
 #include "bootinit/paging.h"
 #include "fsys/fs.h"
 #include "sys/syscall.h"
 #include "sys/pcb.h"
 #include "terminal.h"
 #include "pit.h"
+#include "scheduler.h"
+#include "mm/pmm.h"
+#include "mm/slab.h"
+#include "pipe.h"
 #define RUN_TESTS
 
 /* Macros. */
@@ -29,8 +34,8 @@ void entry(unsigned long magic, unsigned long addr) {
 
     multiboot_info_t *mbi;
 
-    /* Clear the screen. */
-    clear();
+    /* Clear the screens. */
+    init_screens();
 
     /* Am I booted by a Multiboot-compliant boot loader? */
     if (magic != MULTIBOOT_BOOTLOADER_MAGIC) {
@@ -142,6 +147,9 @@ void entry(unsigned long magic, unsigned long addr) {
         tss.ss0 = KERNEL_DS;
         tss.esp0 = 0x800000;
         ltr(KERNEL_TSS);
+
+        /* the fast system call entry uses the tss to find its stack */
+        init_sysenter();
     }
 
     /* Construct the IDT */
@@ -150,6 +158,14 @@ void entry(unsigned long magic, unsigned long addr) {
     /* initialize the pointer to the start of the filesystem */
     module_t* mod = (module_t*)mbi->mods_addr;
     bootblock = (bootblock_t*)mod->mod_start;
+    init_fs();
+
+    /* find out which physical memory we can hand to processes */
+    pmm_init(mbi);
+
+    /* and which part of the kernel's own page is left over for its objects */
+    slab_init(mbi);
+    init_pipes();
 
     /* turn on paging */
     page_init();
@@ -164,9 +180,11 @@ void entry(unsigned long magic, unsigned long addr) {
     init_keyboard();
     init_rtc();
     init_pit();
+    init_serial();
 
     /* initialize the process data */
     init_pcb();
+    init_scheduler();
     executing_initial_shell = 1;
 
     /* initialize the terminal structures */
@@ -15,6 +15,9 @@
 #include "sys/pcb.h"
 #include "constants.h"
 
+/* processes waiting for a line of input on each terminal */
+static wait_queue_t read_queues[NUM_TERMS];
+
 #define MASTER_PORT_A 0x20
 #define SLAVE_PORT_A 0xA0
 #define MASTER_START_INTERRUPT 0x20
@@ -43,12 +46,28 @@
 #define F2_PRESS		0x3C
 #define F3_PRESS		0x3D
 
+#define EXTENDED_CODE		0xE0
+#define PAGE_UP_PRESS		0x49
+#define PAGE_DOWN_PRESS	0x51
+#define SCROLL_LINES		(TERM_ROWS / 2)
+
 static int caps_flag = 0;
 static int shift_flag = 0;
 static int control_flag = 0;
 static int alt_flag = 0;
 static int enter_flag = 0;
 static int backspace_flag = 0;
+static int extended_flag = 0;
+
+/* Scancodes waiting for process_keyboard_input. The interrupt handler is
+ * the only one to move head and process_keyboard_input the only one to
+ * move tail, so neither needs a lock. */
+#define SCANCODE_RING_SIZE 64
+static volatile uint8_t scancode_ring[SCANCODE_RING_SIZE];
+static volatile uint32_t scancode_head = 0;
+static volatile uint32_t scancode_tail = 0;
+
+static int32_t handle_scancode(uint8_t c);
 
 // PS2 keyboard scancode can be seen here:
 // http://www.quadibloc.com/comp/scan.htm
@@ -126,11 +145,12 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t length) {
 	if(buf == NULL || length < 0)
 		return 0;
 
-	/* return unless buffer is ready to be read */
-	/* I'm pretty sure it doesnt matter which read_flag we read bc they technically should be the same */
+	/* sleep until enter is pressed on our terminal */
+	cli();
 	while(!terminal[curr_pcb->term_index].read_ready) {
-		curr_pcb->is_yield = 1; // yield our time slice
+		sleep_on(&read_queues[curr_pcb->term_index]);
 	}
+	sti();
 
 	/* read from input to old terminal buffer */
 	cli();
@@ -173,24 +193,26 @@ int32_t terminal_write(int32_t fd, const void* buf, int32_t length) {
 	if(buf == NULL || length < 0)
 		return 0;
 
-	/* check to ensure buf.size > length, otherwise reassign length */
-	int buflen = strlen((int8_t*) buf);
-	if(buflen < length)
-		length = buflen;
-  /* print each buffer value to terminal */
-	for(i = 0; i < length; i ++) {
-		cli();
-		if (visible_terminal == curr_pcb->term_index) {
-			putc(((uint8_t*)buf)[i]);
-		} else {
-			term_putc(((uint8_t*)buf)[i]);
+	/* stop at a NUL, but never look past length: buf need not be terminated */
+	for(i = 0; i < length; i++) {
+		if(((const uint8_t*)buf)[i] == '\0') {
+			length = i;
+			break;
 		}
-		sti();
+	}
+	/* print the whole buffer to our terminal at once */
+	term_write(curr_pcb->term_index, (const uint8_t*)buf, length);
+
+	/* a newline ends whatever line was being typed */
+	for(i = 0; i < length; i++) {
 		if(((uint8_t*)buf)[i] == '\n') {
+			cli();
 			for(j = 0; j < MAXBUFFER; j++) {
 				terminal[curr_pcb->term_index].new_term_buffer[j] = '\0';
 			}
 			terminal[curr_pcb->term_index].term_buffer_index = 0;
+			sti();
+			break;
 		}
 	}
 
@@ -211,119 +233,171 @@ void init_keyboard() {
 /* void handle_keyboard_interrupt()
  * Inputs: none
  * Return Value: none
- * Function: Handles keyboard interrupt and outputs key press to screen
+ * Function: Handles keyboard interrupt by queueing the scancode for
+ * process_keyboard_input. A full ring drops the key.
  */
 void handle_keyboard_interrupt() {
   	/* clear interrupts */
 		disable_irq(IRQ_KEYBOARD);
 		send_eoi(IRQ_KEYBOARD);
 
-    uint8_t c = 0x00;
-	  do {
-			  /* read from 0x60 = data port from keyboard controller */
-				c = inb(KEYBOARD_PORT);
-				/* if key code is negative, then button has been released */
-        if (c & HIGH_BITMASK)
-				{
-					/* check for button releases */
-					if(c == LEFT_SHIFT_RELEASE || c == RIGHT_SHIFT_RELEASE)
-						shift_flag = 0;
-					else if(c == CONTROL_RELEASE)
-						control_flag = 0;
-					else if(c == ALT_RELEASE)
-						alt_flag = 0;
-					/* check for capslock toggle */
-					else if(c == CAPS_PRESS)
-						caps_flag ^= 1;
-				}
-				else    /* button is being pressed */
-				{
-					/* check for capslock toggle */
-					if(c == CAPS_PRESS)
-						caps_flag ^= 1;
-					/* check for button press */
-					else if(c == BACKSPACE_PRESS)
-						backspace_flag = 1;
-					else if(c == ENTER_PRESS) {
-						enter_flag = 1;
-					}
-					else if(c == CONTROL_PRESS)
-						control_flag = 1;
-					else if(c == ALT_PRESS)
-						alt_flag = 1;
-					else if(c == LEFT_SHIFT_PRESS || c == RIGHT_SHIFT_PRESS)
-						shift_flag = 1;
-
-
-					/* if cntrl-l is pressed, clear screen */
-					if(control_flag && c == L_PRESS) {
-						clear();
-						reset_position();
-					}
-					/* if ALT-F1 is pressed, switch to terminal 1 */
-					else if(alt_flag && c == F1_PRESS) {
-						if (num_procs < MAX_PROCS || terminal[FIRST_TERM].is_started == 1)
-							switch_terminal(FIRST_TERM);
-					}
-					/* if ALT-F2 is pressed, switch to terminal 2 */
-					else if(alt_flag && c == F2_PRESS) {
-						if (num_procs < MAX_PROCS || terminal[SECOND_TERM].is_started == 1)
-							switch_terminal(SECOND_TERM);
-					}
-					/* if ALT-F3 is pressed, switch to terminal 3 */
-					else if(alt_flag && c == F3_PRESS) {
-						if (num_procs < MAX_PROCS || terminal[THIRD_TERM].is_started == 1)
-							switch_terminal(THIRD_TERM);
-					}
-
-					/* if cntrl-l is pressed, clear screen */
-					if(control_flag && c == L_PRESS) {
-						clear();
-						reset_position();
-						//update_cursor();
-					}
-					/* if control is held down, do not print any characters */
-					else if(control_flag)
-						break;
-					/* if backspace is pressed */
-					else if(backspace_flag)
-						backspace_buffer();
-					/* if enter is pressed */
-					else if(enter_flag) {
-						write_to_buffer('\n');
-						enter_buffer();
-						terminal[visible_terminal].read_ready = 1;
-					}
-					/*if shift and caps */
-					else if(shift_flag && caps_flag) {
-						if (keyboard_output4[c] != '\0')
-							write_to_buffer(keyboard_output4[c]);
-					}
-					/*if only shift*/
-					else if(shift_flag && !caps_flag) {
-						if (keyboard_output2[c] != '\0')
-							write_to_buffer(keyboard_output2[c]);
-					}
-					/*if only caps*/
-					else if(!shift_flag && caps_flag) {
-						if (keyboard_output3[c] != '\0')
-							write_to_buffer(keyboard_output3[c]);
-					}
-					/*if neither*/
-					else {
-						if (keyboard_output1[c] != '\0')
-							write_to_buffer(keyboard_output1[c]);
-					}
-				}
-				break;
-
-    } while(1);
-
+		/* read from 0x60 = data port from keyboard controller */
+		uint8_t c = inb(KEYBOARD_PORT);
+		if (scancode_head - scancode_tail < SCANCODE_RING_SIZE) {
+			scancode_ring[scancode_head % SCANCODE_RING_SIZE] = c;
+			scancode_head++;
+		}
 
     /* set interrupts */
 		enable_irq(IRQ_KEYBOARD);
 }
 
+/* void process_keyboard_input()
+ * Inputs: none
+ * Return Value: none
+ * Function: Handles the queued scancodes, outside the interrupt handler.
+ * Called by the keyboard linkage once the interrupt has been acknowledged.
+ * Each key is taken off the ring and handled with interrupts off, but
+ * they are let in between keys, so a burst of keys (or a terminal switch
+ * starting a shell) doesn't hold off the pit.
+ */
+void process_keyboard_input() {
+		uint32_t flags;
+		int32_t switch_to;
+
+		cli_and_save(flags);
+		while (scancode_tail != scancode_head) {
+			uint8_t c = scancode_ring[scancode_tail % SCANCODE_RING_SIZE];
+			scancode_tail++;
+			switch_to = handle_scancode(c);
+
+			sti();
+			if (switch_to >= 0)
+				switch_terminal(switch_to);
+			cli();
+		}
+		restore_flags(flags);
+}
+
+/* int32_t handle_scancode(uint8_t c)
+ * Inputs: c - the scancode to handle
+ * Return Value: the terminal to switch to, -1 to stay
+ * Function: Updates the modifier flags and outputs key press to screen
+ */
+static int32_t handle_scancode(uint8_t c) {
+		/* the next code is an extended key (arrows, page up, etc) */
+		if (c == EXTENDED_CODE) {
+			extended_flag = 1;
+			return -1;
+		}
+		int32_t extended = extended_flag;
+		int32_t switch_to = -1;
+		extended_flag = 0;
+
+		/* if key code is negative, then button has been released */
+		if (c & HIGH_BITMASK)
+		{
+			/* check for button releases. Extended shift codes are the fake
+			 * shifts some keyboards wrap around the extended keys */
+			if((c == LEFT_SHIFT_RELEASE || c == RIGHT_SHIFT_RELEASE) && !extended)
+				shift_flag = 0;
+			else if(c == CONTROL_RELEASE)
+				control_flag = 0;
+			else if(c == ALT_RELEASE)
+				alt_flag = 0;
+			/* check for capslock toggle */
+			else if(c == CAPS_PRESS)
+				caps_flag ^= 1;
+		}
+		else    /* button is being pressed */
+		{
+			/* check for capslock toggle */
+			if(c == CAPS_PRESS)
+				caps_flag ^= 1;
+			/* check for button press */
+			else if(c == BACKSPACE_PRESS)
+				backspace_flag = 1;
+			else if(c == ENTER_PRESS) {
+				enter_flag = 1;
+			}
+			else if(c == CONTROL_PRESS)
+				control_flag = 1;
+			else if(c == ALT_PRESS)
+				alt_flag = 1;
+			else if((c == LEFT_SHIFT_PRESS || c == RIGHT_SHIFT_PRESS) && !extended)
+				shift_flag = 1;
+
+
+			/* if cntrl-l is pressed, clear screen */
+			if(control_flag && c == L_PRESS) {
+				clear();
+				reset_position();
+			}
+			/* if ALT-F1 is pressed, switch to terminal 1 */
+			else if(alt_flag && c == F1_PRESS) {
+				if (num_procs < MAX_PROCS || terminal[FIRST_TERM].is_started == 1)
+					switch_to = FIRST_TERM;
+			}
+			/* if ALT-F2 is pressed, switch to terminal 2 */
+			else if(alt_flag && c == F2_PRESS) {
+				if (num_procs < MAX_PROCS || terminal[SECOND_TERM].is_started == 1)
+					switch_to = SECOND_TERM;
+			}
+			/* if ALT-F3 is pressed, switch to terminal 3 */
+			else if(alt_flag && c == F3_PRESS) {
+				if (num_procs < MAX_PROCS || terminal[THIRD_TERM].is_started == 1)
+					switch_to = THIRD_TERM;
+			}
+			/* if SHIFT-PAGEUP/PAGEDOWN is pressed, move through the scrollback */
+			else if(shift_flag && c == PAGE_UP_PRESS)
+				scroll_view(visible_terminal, SCROLL_LINES);
+			else if(shift_flag && c == PAGE_DOWN_PRESS)
+				scroll_view(visible_terminal, -SCROLL_LINES);
+
+			/* if cntrl-l is pressed, clear screen */
+			if(control_flag && c == L_PRESS) {
+				clear();
+				reset_position();
+				//update_cursor();
+			}
+			/* if control is held down, do not print any characters */
+			else if(control_flag)
+				return switch_to;
+			/* if backspace is pressed */
+			else if(backspace_flag)
+				backspace_buffer();
+			/* if enter is pressed */
+			else if(enter_flag) {
+				write_to_buffer('\n');
+				enter_buffer();
+				terminal[visible_terminal].read_ready = 1;
+				wake_up(&read_queues[visible_terminal]);
+			}
+			/*if shift and caps */
+			else if(shift_flag && caps_flag) {
+				if (keyboard_output4[c] != '\0')
+					write_to_buffer(keyboard_output4[c]);
+			}
+			/*if only shift*/
+			else if(shift_flag && !caps_flag) {
+				if (keyboard_output2[c] != '\0')
+					write_to_buffer(keyboard_output2[c]);
+			}
+			/*if only caps*/
+			else if(!shift_flag && caps_flag) {
+				if (keyboard_output3[c] != '\0')
+					write_to_buffer(keyboard_output3[c]);
+			}
+			/*if neither*/
+			else {
+				if (keyboard_output1[c] != '\0')
+					write_to_buffer(keyboard_output1[c]);
+			}
+		}
+
+		return switch_to;
+}
+
 /* void write_to_buffer(uint8_t k)
  * Inputs: the character to write to the terminal buffer
  * Return Value: none
@@ -335,6 +409,9 @@ extern void write_to_buffer(uint8_t k) {
 		return;
 	}
 
+	/* typing goes back to the live screen */
+	scroll_view(visible_terminal, -SCROLLBACK_LINES);
+
 	/* If it hasnt, write to terminal */
 	terminal[visible_terminal].new_term_buffer[terminal[visible_terminal].term_buffer_index] = k;
 	putc(k);
@@ -349,6 +426,7 @@ extern void write_to_buffer(uint8_t k) {
 extern void backspace_buffer(void) {
 	/* check to ensure beginning of line is not reached */
 	if(terminal[visible_terminal].term_buffer_index > 0) {
+		scroll_view(visible_terminal, -SCROLLBACK_LINES);
 		terminal[visible_terminal].term_buffer_index--;
 		terminal[visible_terminal].new_term_buffer[terminal[visible_terminal].term_buffer_index] = '\0';
 		decrement_position();
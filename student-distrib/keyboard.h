@@ -25,10 +25,17 @@ extern void init_keyboard();
 /* void handle_keyboard_interrupt()
  * Inputs: none
  * Return Value: none
- * Function: Handles keyboard interrupt and outputs key press to screen
+ * Function: Handles keyboard interrupt by queueing the scancode
  */
 extern void handle_keyboard_interrupt();
 
+/* void process_keyboard_input()
+ * Inputs: none
+ * Return Value: none
+ * Function: Handles the queued scancodes and outputs key presses to screen
+ */
+extern void process_keyboard_input();
+
 /* void write_to_buffer(uint8_t k)
  * Inputs: the character to write to the terminal buffer
  * Return Value: none
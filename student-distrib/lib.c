@@ -6,6 +6,7 @@
 #include "scheduler.h"
 #include "sys/syscall.h"
 #include "terminal.h"
+#include "serial.h"
 
 #define VIDEO 0xB8000
 #define NUM_COLS 80
@@ -16,29 +17,201 @@
 #define CURSOR_REG2 0x3D5
 #define CURSOR_DATA1 0x0F
 #define CURSOR_DATA2 0x0E
+#define START_DATA1 0x0D
+#define START_DATA2 0x0C
+#define PAGE_CELLS (PAGE_4KB >> 1)
 #define DATA_PORT 0x40
 #define LOW_BYTE 0xFF
 #define HIGH_BYTE 8
 
+#define ALL_ROWS ((1 << NUM_ROWS) - 1)
+/* the most characters term_write draws with interrupts off */
+#define TERM_WRITE_CHUNK 256
+
+/* Every terminal is drawn into a cacheable copy of its screen first. The
+ * rows form a ring starting at top, so scrolling just moves top along and
+ * blanks the row that comes around. dirty has a bit per screen line that
+ * still has to be copied out to the terminal's (uncached) video page. */
+typedef struct {
+  uint16_t cells[NUM_ROWS][NUM_COLS];
+  uint32_t top;
+  uint32_t dirty;
+} shadow_screen_t;
+
+/* The lines that scrolled off the top of a terminal, oldest first from
+ * head - count. view is how many lines the display is scrolled back by,
+ * 0 while it shows the live screen. */
+typedef struct {
+  uint16_t lines[SCROLLBACK_LINES][NUM_COLS];
+  uint32_t head;
+  uint32_t count;
+  uint32_t view;
+} scrollback_t;
+
 static int screen_x;
 static int screen_y;
-static char* video_mem = (char*)VIDEO;
+static uint16_t page_start;
+static shadow_screen_t shadow[NUM_TERMS];
+static scrollback_t scrollback[NUM_TERMS];
+
+/* uint16_t term_attrib(int32_t term);
+ * Inputs: term = terminal number
+ * Return Value: the text color of the terminal
+ * Function: picks the attribute byte each terminal is drawn with */
+static uint16_t term_attrib(int32_t term) {
+  if (term == SECOND_TERM) return CURSOR2;
+  if (term == THIRD_TERM) return CURSOR3;
+  return CURSOR1;
+}
+
+/* uint16_t* shadow_row(int32_t term, uint32_t line);
+ * Inputs: term = terminal number
+ *         line = row on the screen (0 - 24)
+ * Return Value: the cells of that row in the terminal's shadow screen
+ * Function: maps a screen row onto the ring of shadow rows */
+static uint16_t* shadow_row(int32_t term, uint32_t line) {
+  return shadow[term].cells[(shadow[term].top + line) % NUM_ROWS];
+}
+
+/* void shadow_clear(int32_t term);
+ * Inputs: term = terminal number
+ * Return Value: none
+ * Function: blanks a shadow screen in the terminal's color */
+static void shadow_clear(int32_t term) {
+  memset_word(shadow[term].cells, (term_attrib(term) << HIGH_BYTE) | ' ',
+              NUM_ROWS * NUM_COLS);
+  shadow[term].top = 0;
+  shadow[term].dirty = ALL_ROWS;
+}
+
+/* void shadow_scroll(int32_t term);
+ * Inputs: term = terminal number
+ * Return Value: none
+ * Function: scrolls a shadow screen up a line by turning the ring. The
+ *           line leaving the top is appended to the scrollback and the
+ *           row coming in at the bottom is blanked, but every line on the
+ *           screen now shows a different row so all of them are dirty. */
+static void shadow_scroll(int32_t term) {
+  scrollback_t* hist = &scrollback[term];
+
+  memcpy(hist->lines[hist->head], shadow_row(term, 0),
+         NUM_COLS * sizeof(uint16_t));
+  hist->head = (hist->head + 1) % SCROLLBACK_LINES;
+  if (hist->count < SCROLLBACK_LINES) hist->count++;
+  /* keep a scrolled back display on the same text */
+  if (hist->view > 0 && hist->view < hist->count) hist->view++;
+
+  memset_word(shadow_row(term, 0), (term_attrib(term) << HIGH_BYTE) | ' ',
+              NUM_COLS);
+  shadow[term].top = (shadow[term].top + 1) % NUM_ROWS;
+  shadow[term].dirty = ALL_ROWS;
+}
+
+/* void flush_screen(int32_t term);
+ * Inputs: term = terminal number
+ * Return Value: none
+ * Function: copies the dirty rows of a terminal's shadow screen out to
+ *           its video page, unless it is showing the scrollback */
+void flush_screen(int32_t term) {
+  uint16_t* page;
+  uint32_t line, flags;
+
+  if (term < FIRST_TERM || term > THIRD_TERM) return;
+  /* the page shows the scrollback, the dirty rows wait until it doesn't */
+  if (scrollback[term].view > 0) return;
+
+  cli_and_save(flags);
+  page = (uint16_t*)(VIDEO + PAGE_4KB * (term + 1));
+  for (line = 0; shadow[term].dirty != 0; line++) {
+    if (shadow[term].dirty & (1 << line)) {
+      memcpy(page + line * NUM_COLS, shadow_row(term, line),
+             NUM_COLS * sizeof(uint16_t));
+      shadow[term].dirty &= ~(1 << line);
+    }
+  }
+  restore_flags(flags);
+}
+
+/* void flush_screens(void);
+ * Inputs: void
+ * Return Value: none
+ * Function: flushes every terminal. Called on each timer tick to pick up
+ *           the single characters putc leaves behind. */
+void flush_screens(void) {
+  int32_t term;
+  for (term = FIRST_TERM; term <= THIRD_TERM; term++) {
+    flush_screen(term);
+  }
+}
+
+/* void scroll_view(int32_t term, int32_t lines);
+ * Inputs: term = terminal number
+ *         lines = how far to move the display back into the scrollback,
+ *                 negative to move it forward
+ * Return Value: none
+ * Function: redraws a terminal's video page from its scrollback and
+ *           screen, starting the given number of lines further back.
+ *           Moving all the way forward shows the live screen again. */
+void scroll_view(int32_t term, int32_t lines) {
+  scrollback_t* hist;
+  uint16_t* page;
+  uint32_t line, first, flags;
+  int32_t view;
+
+  if (term < FIRST_TERM || term > THIRD_TERM) return;
+
+  cli_and_save(flags);
+  hist = &scrollback[term];
+  view = (int32_t)hist->view + lines;
+  if (view < 0) view = 0;
+  if (view > (int32_t)hist->count) view = hist->count;
+  if (view == (int32_t)hist->view) {
+    restore_flags(flags);
+    return;
+  }
+  hist->view = view;
+
+  /* lines before first come from the scrollback, the rest from the
+   * top of the live screen */
+  page = (uint16_t*)(VIDEO + PAGE_4KB * (term + 1));
+  first = hist->count - view;
+  for (line = 0; line < NUM_ROWS; line++) {
+    if (first + line < hist->count) {
+      memcpy(page + line * NUM_COLS,
+             hist->lines[(hist->head + SCROLLBACK_LINES - hist->count +
+                          first + line) % SCROLLBACK_LINES],
+             NUM_COLS * sizeof(uint16_t));
+    } else {
+      memcpy(page + line * NUM_COLS,
+             shadow_row(term, first + line - hist->count),
+             NUM_COLS * sizeof(uint16_t));
+    }
+  }
+  shadow[term].dirty = 0;
+  restore_flags(flags);
+}
+
+/* void init_screens(void);
+ * Inputs: void
+ * Return Value: none
+ * Function: blanks every terminal's screen in its color and shows the
+ *           first terminal */
+void init_screens(void) {
+  int32_t term;
+  for (term = FIRST_TERM; term <= THIRD_TERM; term++) {
+    shadow_clear(term);
+    flush_screen(term);
+  }
+  show_terminal_page(FIRST_TERM);
+  reset_position();
+}
 
 /* void clear(void);
  * Inputs: void
  * Return Value: none
  * Function: Clears video memory */
 void clear(void) {
-  int32_t i;
-  for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
-    *(uint8_t*)(video_mem + (i << 1)) = ' ';
-    if (visible_terminal == FIRST_TERM)
-      *(uint8_t*)(video_mem + (i << 1) + 1) = CURSOR1;
-    if (visible_terminal == SECOND_TERM)
-      *(uint8_t*)(video_mem + (i << 1) + 1) = CURSOR2;
-    if (visible_terminal == THIRD_TERM)
-      *(uint8_t*)(video_mem + (i << 1) + 1) = CURSOR3;
-  }
+  shadow_clear(visible_terminal);
 }
 
 /* void reset_position(void);
@@ -80,12 +253,7 @@ void enter_position(void) {
  * 	Function: shift all characters up by one line
  */
 void scroll_up(void) {
-  memmove(video_mem, video_mem + ((NUM_COLS) << 1),
-          (NUM_COLS * (NUM_ROWS - 1)) << 1);
-  uint8_t i;
-  for (i = 0; i < NUM_COLS; i++) {
-    *(uint8_t*)(video_mem + ((NUM_COLS * (NUM_ROWS - 1) + i) << 1)) = ' ';
-  }
+  shadow_scroll(visible_terminal);
   screen_y--;
 }
 
@@ -97,16 +265,7 @@ void scroll_up(void) {
  *            in terminal currently running process
  */
 void term_scroll_up(void) {
-  memmove((char*)(VIDEO + PAGE_4KB * (curr_pcb->term_index + 1)),
-          (char*)(VIDEO + PAGE_4KB * (curr_pcb->term_index + 1)) +
-              ((NUM_COLS) << 1),
-          (NUM_COLS * (NUM_ROWS - 1)) << 1);
-
-  uint8_t i;
-  for (i = 0; i < NUM_COLS; i++) {
-    *(uint8_t*)((VIDEO + PAGE_4KB * (curr_pcb->term_index + 1)) +
-                ((NUM_COLS * (NUM_ROWS - 1) + i) << 1)) = ' ';
-  }
+  shadow_scroll(curr_pcb->term_index);
   (terminal[curr_pcb->term_index].term_screen_y)--;
 }
 
@@ -118,7 +277,7 @@ void term_scroll_up(void) {
   *	 Function: update the cursor position in screen
   */
 void update_cursor(void) {
-  unsigned short pos = (screen_y * NUM_COLS) + screen_x;
+  unsigned short pos = page_start + (screen_y * NUM_COLS) + screen_x;
 
   outb(CURSOR_DATA1, CURSOR_REG1);
   outb((unsigned char)(pos & LOW_BYTE), CURSOR_REG2);
@@ -127,6 +286,23 @@ void update_cursor(void) {
   outb((unsigned char)((pos >> HIGH_BYTE) & LOW_BYTE), CURSOR_REG2);
 }
 
+/*
+ * void show_terminal_page()
+ *   Inputs: terminal number to display
+ *   Return Value: none
+ *	 Function: points the CRTC start address at the terminal's page of
+ *             text memory
+ */
+void show_terminal_page(uint8_t term_num) {
+  page_start = PAGE_CELLS * (term_num + 1);
+
+  outb(START_DATA1, CURSOR_REG1);
+  outb((unsigned char)(page_start & LOW_BYTE), CURSOR_REG2);
+
+  outb(START_DATA2, CURSOR_REG1);
+  outb((unsigned char)((page_start >> HIGH_BYTE) & LOW_BYTE), CURSOR_REG2);
+}
+
 /*
  * void set_terminal_position()
  *   Inputs: current terminal number
@@ -264,6 +440,7 @@ int32_t printf(int8_t* format, ...) {
     }
     buf++;
   }
+  flush_screen(visible_terminal);
   return (buf - format);
 }
 
@@ -277,6 +454,7 @@ int32_t puts(int8_t* s) {
     putc(s[index]);
     index++;
   }
+  flush_screen(visible_terminal);
   return index;
 }
 
@@ -285,22 +463,16 @@ int32_t puts(int8_t* s) {
  * Return Value: void
  *  Function: Output a character to the console */
 void putc(uint8_t c) {
+  serial_log(&c, 1);
   if (screen_x >= NUM_COLS - 1 && screen_y >= NUM_ROWS - 1) scroll_up();
   if (c == '\n' || c == '\r') {
     if (screen_y >= NUM_ROWS - 1) scroll_up();
     screen_y++;
     screen_x = 0;
   } else {
-    *(uint8_t*)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = c;
-    if (visible_terminal == FIRST_TERM)
-      *(uint8_t*)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) =
-          CURSOR1;
-    if (visible_terminal == SECOND_TERM)
-      *(uint8_t*)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) =
-          CURSOR2;
-    if (visible_terminal == THIRD_TERM)
-      *(uint8_t*)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) =
-          CURSOR3;
+    shadow_row(visible_terminal, screen_y)[screen_x] =
+        (term_attrib(visible_terminal) << HIGH_BYTE) | c;
+    shadow[visible_terminal].dirty |= 1 << screen_y;
     screen_x++;
     screen_y = (screen_y + (screen_x / NUM_COLS)) % NUM_ROWS;
     screen_x %= NUM_COLS;
@@ -327,22 +499,14 @@ void term_putc(uint8_t c) {
     (terminal[curr_pcb->term_index].term_screen_y)++;
     terminal[curr_pcb->term_index].term_screen_x = 0;
   } else {
-    /* update video memory of terminal currently running a process
+    /* update the screen of terminal currently running a process
      * by adding character c */
-    *(uint8_t*)((VIDEO + PAGE_4KB * (curr_pcb->term_index + 1)) +
-                ((NUM_COLS * terminal[curr_pcb->term_index].term_screen_y +
-                  terminal[curr_pcb->term_index].term_screen_x)
-                 << 1)) = c;
-    /* update text color based on terminal currently visible */
-    if (visible_terminal == FIRST_TERM)
-      *(uint8_t*)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) =
-          CURSOR1;
-    if (visible_terminal == SECOND_TERM)
-      *(uint8_t*)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) =
-          CURSOR2;
-    if (visible_terminal == THIRD_TERM)
-      *(uint8_t*)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) =
-          CURSOR3;
+    shadow_row(curr_pcb->term_index,
+               terminal[curr_pcb->term_index].term_screen_y)
+        [terminal[curr_pcb->term_index].term_screen_x] =
+        (term_attrib(curr_pcb->term_index) << HIGH_BYTE) | c;
+    shadow[curr_pcb->term_index].dirty |=
+        1 << terminal[curr_pcb->term_index].term_screen_y;
 
     /* update position of screen for terminal currently running a process */
     terminal[curr_pcb->term_index].term_screen_x++;
@@ -354,6 +518,85 @@ void term_putc(uint8_t c) {
   }
 }
 
+/* void term_write_chunk(int32_t term, const uint8_t* buf, int32_t n);
+ * Inputs: term = the terminal to write to
+ *         buf = the characters to print
+ *         n = how many characters to print
+ * Return Value: void
+ *  Function: Output part of a buffer to a terminal with interrupts off.
+ *            Scrolling only turns the shadow screen's ring, so every line
+ *            that scrolls off still reaches the scrollback. The changed rows
+ *            reach video memory in one flush and the hardware cursor is
+ *            moved once at the end. */
+static void term_write_chunk(int32_t term, const uint8_t* buf, int32_t n) {
+  uint32_t x, y;
+  uint16_t attrib;
+  int32_t i;
+
+  uint32_t flags;
+  cli_and_save(flags);
+
+  // the visible terminal's position lives in screen_x/y, the others' in
+  // their terminal struct
+  if (term == visible_terminal) {
+    x = screen_x;
+    y = screen_y;
+  } else {
+    x = terminal[term].term_screen_x;
+    y = terminal[term].term_screen_y;
+  }
+  attrib = term_attrib(term) << HIGH_BYTE;
+
+  for (i = 0; i < n; i++) {
+    uint8_t c = buf[i];
+    if (c != '\n' && c != '\r') {
+      shadow_row(term, y)[x] = attrib | c;
+      shadow[term].dirty |= 1 << y;
+      if (++x < NUM_COLS) continue;
+    }
+    /* newline or wrap: move down, scrolling at the bottom row */
+    x = 0;
+    if (y < NUM_ROWS - 1)
+      y++;
+    else
+      shadow_scroll(term);
+  }
+  flush_screen(term);
+
+  if (term == visible_terminal) {
+    screen_x = x;
+    screen_y = y;
+    update_cursor();
+  } else {
+    terminal[term].term_screen_x = x;
+    terminal[term].term_screen_y = y;
+  }
+
+  restore_flags(flags);
+}
+
+/* void term_write(int32_t term, const uint8_t* buf, int32_t n);
+ * Inputs: term = the terminal to write to
+ *         buf = the characters to print
+ *         n = how many characters to print
+ * Return Value: void
+ *  Function: Output a buffer to a terminal. A long buffer is drawn
+ *            TERM_WRITE_CHUNK characters at a time so interrupts get in
+ *            between the chunks, and each chunk goes to the serial log
+ *            once it is on the screen. */
+void term_write(int32_t term, const uint8_t* buf, int32_t n) {
+  int32_t done, len;
+
+  if (term < FIRST_TERM || term > THIRD_TERM || buf == NULL || n <= 0) return;
+
+  for (done = 0; done < n; done += len) {
+    len = n - done;
+    if (len > TERM_WRITE_CHUNK) len = TERM_WRITE_CHUNK;
+    term_write_chunk(term, buf + done, len);
+    serial_log(buf + done, len);
+  }
+}
+
 /* int8_t* itoa(uint32_t value, int8_t* buf, int32_t radix);
  * Inputs: uint32_t value = number to convert
  *            int8_t* buf = allocated buffer to place string in
@@ -644,6 +887,8 @@ int8_t* strncpy(int8_t* dest, const int8_t* src, uint32_t n) {
 void test_interrupts(void) {
   int32_t i;
   for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
-    video_mem[i << 1]++;
+    ((uint8_t*)shadow[visible_terminal].cells)[i << 1]++;
   }
+  shadow[visible_terminal].dirty = ALL_ROWS;
+  flush_screen(visible_terminal);
 }
@@ -7,6 +7,9 @@
 
 #include "types.h"
 
+/* how many lines that scrolled off each terminal are kept */
+#define SCROLLBACK_LINES 2048
+
 int32_t printf(int8_t *format, ...);
 void putc(uint8_t c);
 int32_t puts(int8_t *s);
@@ -21,6 +24,42 @@ uint32_t strlen(const int8_t* s);
  *            which is currently running a process */
 void term_putc(uint8_t c);
 
+/* void term_write(int32_t term, const uint8_t* buf, int32_t n);
+ * Inputs: term = the terminal to write to
+ *         buf = the characters to print
+ *         n = how many characters to print
+ * Return Value: void
+ *  Function: Output a buffer to a terminal in chunks, flushing the screen
+ *            and moving the hardware cursor once per chunk */
+void term_write(int32_t term, const uint8_t* buf, int32_t n);
+
+/* void flush_screen(int32_t term);
+ * Inputs: term = the terminal to flush
+ * Return Value: void
+ *  Function: Copy the rows of a terminal that changed since the last flush
+ *            out to its video page */
+void flush_screen(int32_t term);
+
+/* void flush_screens(void);
+ * Inputs: void
+ * Return Value: void
+ *  Function: Flush every terminal */
+void flush_screens(void);
+
+/* void scroll_view(int32_t term, int32_t lines);
+ * Inputs: term = the terminal to scroll
+ *         lines = how many lines to look further back, negative for forward
+ * Return Value: none
+ * Function: Shows a terminal's scrollback. Back at 0 it shows the live
+ *           screen again */
+void scroll_view(int32_t term, int32_t lines);
+
+/* void init_screens(void);
+ * Inputs: void
+ * Return Value: none
+ * Function: Blanks all terminal screens and shows the first one */
+void init_screens(void);
+
 /* void clear(void);
  * Inputs: void
  * Return Value: none
@@ -71,6 +110,14 @@ void term_scroll_up(void);
   */
 void update_cursor(void);
 
+/*
+  * void show_terminal_page()
+  *   Inputs: terminal number to display
+  *   Return Value: none
+  *	 Function: flips the display to the terminal's own video page
+  */
+void show_terminal_page(uint8_t term_num);
+
 /*
   * void set_terminal_position()
   *   Inputs: current terminal number
@@ -7,4 +7,6 @@ extern void rtc_linkage();
 
 extern void pit_linkage();
 
+extern void serial_linkage();
+
 #endif
@@ -0,0 +1,207 @@
+/**
+ * pmm.c
+ *
+ * The physical memory manager. Every 4 KB frame of physical memory (up to
+ * PMM_MAX_MEMORY) has one bit in a bitmap, set while the frame is in use or
+ * does not exist.
+ */
+
+#include "../lib.h"
+#include "pmm.h"
+
+/* Check if the bit BIT in FLAGS is set. */
+#define CHECK_FLAG(flags, bit)   ((flags) & (1 << (bit)))
+
+/* multiboot memory map type for usable RAM */
+#define MMAP_AVAILABLE  1
+
+/* mem_upper counts kilobytes starting at 1 MB */
+#define ONE_MB          0x00100000
+#define KB_SHIFT        10
+
+#define BITS_PER_WORD   32
+#define FULL_WORD       0xFFFFFFFF
+#define BITMAP_WORDS    (PMM_MAX_FRAMES / BITS_PER_WORD)
+
+static uint32_t frame_bitmap[BITMAP_WORDS];
+static uint32_t free_frames = 0;
+static uint32_t total_frames = 0;
+static uint32_t next_word = 0; // where the next search starts
+
+/* static function declarations */
+static void mark_range(uint32_t start, uint32_t end, int used);
+
+/**
+ * pmm_init()
+ *
+ * DESCRIPTION: builds the frame bitmap from the multiboot memory map (or the
+ * mem_upper size if there is no map), then takes out everything the kernel
+ * and the boot modules occupy.
+ * INPUTS: mbi - the multiboot info structure handed to entry()
+ * OUTPUTS: none
+ */
+void pmm_init(multiboot_info_t* mbi) {
+    uint32_t i;
+
+    // everything starts out used, only memory we are told about is freed
+    for (i = 0; i < BITMAP_WORDS; i++) {
+        frame_bitmap[i] = FULL_WORD;
+    }
+    free_frames = 0;
+
+    if (CHECK_FLAG(mbi->flags, 6)) {
+        memory_map_t* mmap;
+        for (mmap = (memory_map_t*)mbi->mmap_addr;
+             (uint32_t)mmap < mbi->mmap_addr + mbi->mmap_length;
+             mmap = (memory_map_t*)((uint32_t)mmap + mmap->size + sizeof(mmap->size))) {
+            // anything above 4 GB is out of reach anyway
+            if (mmap->type != MMAP_AVAILABLE || mmap->base_addr_high != 0)
+                continue;
+
+            uint32_t start = mmap->base_addr_low;
+            uint32_t end = start + mmap->length_low;
+            if (mmap->length_high != 0 || end < start)
+                end = FULL_WORD; // runs past 4 GB, clipped below
+            mark_range(start, end, 0);
+        }
+    } else if (CHECK_FLAG(mbi->flags, 0)) {
+        mark_range(ONE_MB, ONE_MB + (mbi->mem_upper << KB_SHIFT), 0);
+    }
+
+    // the kernel lives in (and identity maps) the first 8 MB
+    mark_range(0, PMM_KERNEL_END, 1);
+
+    // the boot modules (the filesystem) have to stay where GRUB put them
+    if (CHECK_FLAG(mbi->flags, 3)) {
+        module_t* mod = (module_t*)mbi->mods_addr;
+        for (i = 0; i < mbi->mods_count; i++, mod++) {
+            mark_range(mod->mod_start, mod->mod_end, 1);
+        }
+    }
+
+    total_frames = free_frames;
+    next_word = 0;
+}
+
+/**
+ * pmm_alloc_frame()
+ *
+ * DESCRIPTION: takes one free 4 KB frame. The search picks up where the last
+ * one left off and skips whole words of used frames at a time.
+ * INPUTS: none
+ * OUTPUTS: the physical address of the frame, PMM_NO_FRAME if there are none
+ */
+uint32_t pmm_alloc_frame() {
+    uint32_t flags;
+    uint32_t i, bit;
+
+    cli_and_save(flags);
+    if (free_frames == 0) {
+        restore_flags(flags);
+        return PMM_NO_FRAME;
+    }
+
+    for (i = 0; i < BITMAP_WORDS; i++) {
+        uint32_t word = (next_word + i) % BITMAP_WORDS;
+        if (frame_bitmap[word] == FULL_WORD)
+            continue;
+
+        for (bit = 0; bit < BITS_PER_WORD; bit++) {
+            if (!(frame_bitmap[word] & (1 << bit)))
+                break;
+        }
+
+        frame_bitmap[word] |= (1 << bit);
+        free_frames--;
+        next_word = word;
+        restore_flags(flags);
+        return (word * BITS_PER_WORD + bit) << FRAME_SHIFT;
+    }
+
+    restore_flags(flags);
+    return PMM_NO_FRAME;
+}
+
+/**
+ * pmm_free_frame()
+ *
+ * DESCRIPTION: gives a frame from pmm_alloc_frame back. Frames the kernel
+ * owns and frames that are already free are ignored.
+ * INPUTS: phys_addr - the physical address of the frame
+ * OUTPUTS: none
+ */
+void pmm_free_frame(uint32_t phys_addr) {
+    if (phys_addr < PMM_KERNEL_END || phys_addr >= PMM_MAX_MEMORY)
+        return;
+
+    uint32_t flags;
+    uint32_t frame = phys_addr >> FRAME_SHIFT;
+    uint32_t word = frame / BITS_PER_WORD;
+    uint32_t mask = 1 << (frame % BITS_PER_WORD);
+
+    cli_and_save(flags);
+    if (frame_bitmap[word] & mask) {
+        frame_bitmap[word] &= ~mask;
+        free_frames++;
+        if (word < next_word)
+            next_word = word;
+    }
+    restore_flags(flags);
+}
+
+/**
+ * pmm_free_count()
+ *
+ * DESCRIPTION: returns how many frames are currently free.
+ */
+uint32_t pmm_free_count() {
+    return free_frames;
+}
+
+/**
+ * pmm_total_count()
+ *
+ * DESCRIPTION: returns how many frames were usable after boot.
+ */
+uint32_t pmm_total_count() {
+    return total_frames;
+}
+
+/**
+ * mark_range()
+ *
+ * DESCRIPTION: marks every frame that overlaps [start, end) as used, or every
+ * frame that lies completely inside it as free. Only used during init.
+ * INPUTS: start - the first physical address
+ *         end - the physical address just past the range
+ *         used - 1 to take the frames, 0 to free them
+ * OUTPUTS: none
+ */
+static void mark_range(uint32_t start, uint32_t end, int used) {
+    uint32_t first, last, frame;
+
+    if (end > PMM_MAX_MEMORY)
+        end = PMM_MAX_MEMORY;
+    if (start >= end)
+        return;
+
+    if (used) {
+        first = start >> FRAME_SHIFT;
+        last = (end + FRAME_SIZE - 1) >> FRAME_SHIFT;
+    } else {
+        first = (start + FRAME_SIZE - 1) >> FRAME_SHIFT;
+        last = end >> FRAME_SHIFT;
+    }
+
+    for (frame = first; frame < last; frame++) {
+        uint32_t word = frame / BITS_PER_WORD;
+        uint32_t mask = 1 << (frame % BITS_PER_WORD);
+        if (used && !(frame_bitmap[word] & mask)) {
+            frame_bitmap[word] |= mask;
+            free_frames--;
+        } else if (!used && (frame_bitmap[word] & mask)) {
+            frame_bitmap[word] &= ~mask;
+            free_frames++;
+        }
+    }
+}
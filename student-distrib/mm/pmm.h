@@ -0,0 +1,64 @@
+/**
+ * pmm.h
+ *
+ * Header file for the physical memory manager. Hands out 4 KB physical frames
+ * out of the memory the bootloader told us about.
+ */
+#ifndef _PMM_H
+#define _PMM_H
+
+#include "../types.h"
+#include "../multiboot.h"
+
+/* defines for the frames we track */
+#define FRAME_SIZE      0x1000      // 4 KB
+#define FRAME_SHIFT     12
+#define PMM_MAX_MEMORY  0x40000000  // we only track the first 1 GB
+#define PMM_MAX_FRAMES  (PMM_MAX_MEMORY >> FRAME_SHIFT)
+#define PMM_KERNEL_END  0x00800000  // 0 - 8 MB is the kernel's, never handed out
+#define PMM_NO_FRAME    0           // returned when we are out of memory
+
+/**
+ * pmm_init()
+ *
+ * DESCRIPTION: builds the frame bitmap from the multiboot memory map (or the
+ * mem_upper size if there is no map), then takes out everything the kernel
+ * and the boot modules occupy.
+ * INPUTS: mbi - the multiboot info structure handed to entry()
+ * OUTPUTS: none
+ */
+void pmm_init(multiboot_info_t* mbi);
+
+/**
+ * pmm_alloc_frame()
+ *
+ * DESCRIPTION: takes one free 4 KB frame.
+ * INPUTS: none
+ * OUTPUTS: the physical address of the frame, PMM_NO_FRAME if there are none
+ */
+uint32_t pmm_alloc_frame();
+
+/**
+ * pmm_free_frame()
+ *
+ * DESCRIPTION: gives a frame from pmm_alloc_frame back.
+ * INPUTS: phys_addr - the physical address of the frame
+ * OUTPUTS: none
+ */
+void pmm_free_frame(uint32_t phys_addr);
+
+/**
+ * pmm_free_count()
+ *
+ * DESCRIPTION: returns how many frames are currently free.
+ */
+uint32_t pmm_free_count();
+
+/**
+ * pmm_total_count()
+ *
+ * DESCRIPTION: returns how many frames were usable after boot.
+ */
+uint32_t pmm_total_count();
+
+#endif
@@ -0,0 +1,225 @@
+/**
+ * shm.c
+ *
+ * Shared memory segments. The frames of a segment are taken from the frame
+ * allocator when the first process asks for its key and mapped straight into
+ * every process that asks after that, so whatever one of them writes the
+ * others see without a copy. Segment i always sits at SHM_SEGMENT_ADDR(i),
+ * so pointers into a segment mean the same thing in every process.
+ */
+
+#include "../lib.h"
+#include "../sys/pcb.h"
+#include "../scheduler.h"
+#include "pmm.h"
+#include "slab.h"
+#include "shm.h"
+
+#define PAGE_UP(x)  (((x) + FRAME_SIZE - 1) & ~(FRAME_SIZE - 1))
+
+/**
+ * shm_segment_t - one shared memory segment.
+ *
+ *    key - the name processes ask for it by, 0 while the slot is free
+ *    pages - how many pages it has
+ *    frames - the physical frame of each page, from kmalloc
+ *    refcount - how many processes have it mapped
+ *    ready - 0 while its creator is still zeroing it
+ */
+typedef struct {
+    uint32_t key;
+    uint32_t pages;
+    uint32_t* frames;
+    uint32_t refcount;
+    uint32_t ready;
+} shm_segment_t;
+
+static shm_segment_t segments[SHM_MAX_SEGMENTS];
+
+// processes waiting for a new segment to be zeroed
+static wait_queue_t ready_queue;
+
+/* static function declarations */
+static int32_t create_segment(uint32_t key, uint32_t size);
+static void unmap_segment(int32_t i);
+
+/**
+ * shm_map()
+ *
+ * DESCRIPTION: maps the segment with a key into the current process, making
+ * it if nobody has it yet. A new segment is zeroed through the first mapping,
+ * since its frames may hold an old process's data. That happens with
+ * interrupts on, so anyone else asking for the key meanwhile waits until
+ * the segment is ready.
+ * INPUTS: key - the name of the segment, anything but 0
+ *         size - the bytes the process needs, 0 to take an existing segment
+ *                as it is
+ * OUTPUTS: the address of the segment, NULL on failure
+ */
+void* shm_map(uint32_t key, uint32_t size) {
+    uint32_t flags;
+    int32_t i, created = 0;
+    uint32_t page;
+
+    if (key == 0 || size > SHM_SEGMENT_SIZE || curr_pcb->pid < 0)
+        return NULL;
+
+    cli_and_save(flags);
+    while (1) {
+        for (i = 0; i < SHM_MAX_SEGMENTS; i++) {
+            if (segments[i].key == key)
+                break;
+        }
+        if (i == SHM_MAX_SEGMENTS || segments[i].ready)
+            break;
+        // the old contents must not show through, look again once zeroed
+        sleep_on(&ready_queue);
+    }
+
+    if (i == SHM_MAX_SEGMENTS) {
+        if (size == 0 || (i = create_segment(key, size)) < 0) {
+            restore_flags(flags);
+            return NULL;
+        }
+        created = 1;
+    } else if (size > segments[i].pages * FRAME_SIZE) {
+        restore_flags(flags);
+        return NULL;
+    }
+
+    // mapping it twice just hands out the address again
+    if (!(curr_pcb->shm_mapped & (1 << i))) {
+        for (page = 0; page < segments[i].pages; page++) {
+            map_shm_page(curr_pcb->pid, SHM_SEGMENT_ADDR(i) + page * FRAME_SIZE,
+                         segments[i].frames[page]);
+        }
+        curr_pcb->shm_mapped |= 1 << i;
+        segments[i].refcount++;
+    }
+
+    restore_flags(flags);
+
+    if (created) {
+        memset((void*)SHM_SEGMENT_ADDR(i), 0, segments[i].pages * FRAME_SIZE);
+        cli_and_save(flags);
+        segments[i].ready = 1;
+        wake_up(&ready_queue);
+        restore_flags(flags);
+    }
+
+    return (void*)SHM_SEGMENT_ADDR(i);
+}
+
+/**
+ * shm_unmap()
+ *
+ * DESCRIPTION: unmaps a segment from the current process. The last process to
+ * let go of a segment frees it.
+ * INPUTS: key - the name of the segment
+ * OUTPUTS: 0 if successful, -1 if the process did not have it mapped
+ */
+int32_t shm_unmap(uint32_t key) {
+    uint32_t flags;
+    int32_t i;
+
+    if (key == 0)
+        return -1;
+
+    cli_and_save(flags);
+    for (i = 0; i < SHM_MAX_SEGMENTS; i++) {
+        if (segments[i].key == key && (curr_pcb->shm_mapped & (1 << i))) {
+            unmap_segment(i);
+            restore_flags(flags);
+            return 0;
+        }
+    }
+    restore_flags(flags);
+    return -1;
+}
+
+/**
+ * shm_unmap_all()
+ *
+ * DESCRIPTION: unmaps every segment of the current process, for halt.
+ * INPUTS: none
+ * OUTPUTS: none
+ */
+void shm_unmap_all() {
+    uint32_t flags;
+    int32_t i;
+
+    cli_and_save(flags);
+    for (i = 0; i < SHM_MAX_SEGMENTS; i++) {
+        if (curr_pcb->shm_mapped & (1 << i))
+            unmap_segment(i);
+    }
+    restore_flags(flags);
+}
+
+/**
+ * create_segment()
+ *
+ * DESCRIPTION: takes a free slot and the frames for a new segment. Interrupts
+ * must be off.
+ * INPUTS: key - the name of the segment
+ *         size - its size in bytes, at most SHM_SEGMENT_SIZE
+ * OUTPUTS: the slot, -1 if there is no free slot or not enough memory
+ */
+static int32_t create_segment(uint32_t key, uint32_t size) {
+    uint32_t pages = PAGE_UP(size) / FRAME_SIZE;
+    uint32_t page;
+    int32_t i;
+
+    for (i = 0; i < SHM_MAX_SEGMENTS; i++) {
+        if (segments[i].key == 0)
+            break;
+    }
+    if (i == SHM_MAX_SEGMENTS)
+        return -1;
+
+    uint32_t* frames = kmalloc(pages * sizeof(uint32_t));
+    if (frames == NULL)
+        return -1;
+
+    for (page = 0; page < pages; page++) {
+        frames[page] = pmm_alloc_frame();
+        if (frames[page] == PMM_NO_FRAME) {
+            while (page > 0)
+                pmm_free_frame(frames[--page]);
+            kfree(frames);
+            return -1;
+        }
+    }
+
+    segments[i].key = key;
+    segments[i].pages = pages;
+    segments[i].frames = frames;
+    segments[i].refcount = 0;
+    segments[i].ready = 0;
+    return i;
+}
+
+/**
+ * unmap_segment()
+ *
+ * DESCRIPTION: unmaps a segment from the current process and frees it if
+ * nobody else has it. Interrupts must be off.
+ * INPUTS: i - the slot of the segment
+ * OUTPUTS: none
+ */
+static void unmap_segment(int32_t i) {
+    uint32_t page;
+
+    unmap_shm_range(curr_pcb->pid, SHM_SEGMENT_ADDR(i),
+                    SHM_SEGMENT_ADDR(i) + segments[i].pages * FRAME_SIZE);
+    curr_pcb->shm_mapped &= ~(1 << i);
+
+    if (--segments[i].refcount > 0)
+        return;
+
+    for (page = 0; page < segments[i].pages; page++)
+        pmm_free_frame(segments[i].frames[page]);
+    kfree(segments[i].frames);
+    segments[i].frames = NULL;
+    segments[i].key = 0;
+}
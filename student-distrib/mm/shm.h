@@ -0,0 +1,50 @@
+/**
+ * shm.h
+ *
+ * Header file for shared memory segments. A segment is a set of frames that
+ * every process asking for its key gets mapped at the same address.
+ */
+#ifndef _SHM_H
+#define _SHM_H
+
+#include "../types.h"
+#include "../bootinit/paging.h"
+
+/* the window at SHM_VADDR has room for SHM_MAX_SEGMENTS segments, each one
+ * mapped at its own fixed address in every process */
+#define SHM_MAX_SEGMENTS    4
+#define SHM_SEGMENT_SIZE    (FOUR_MB / SHM_MAX_SEGMENTS)
+#define SHM_SEGMENT_ADDR(i) (SHM_VADDR + (i) * SHM_SEGMENT_SIZE)
+
+/**
+ * shm_map()
+ *
+ * DESCRIPTION: maps the segment with a key into the current process, making
+ * it (zeroed) if nobody has it yet.
+ * INPUTS: key - the name of the segment, anything but 0
+ *         size - the bytes the process needs, 0 to take an existing segment
+ *                as it is
+ * OUTPUTS: the address of the segment, NULL on failure
+ */
+void* shm_map(uint32_t key, uint32_t size);
+
+/**
+ * shm_unmap()
+ *
+ * DESCRIPTION: unmaps a segment from the current process. The last process to
+ * let go of a segment frees it.
+ * INPUTS: key - the name of the segment
+ * OUTPUTS: 0 if successful, -1 if the process did not have it mapped
+ */
+int32_t shm_unmap(uint32_t key);
+
+/**
+ * shm_unmap_all()
+ *
+ * DESCRIPTION: unmaps every segment of the current process, for halt.
+ * INPUTS: none
+ * OUTPUTS: none
+ */
+void shm_unmap_all();
+
+#endif
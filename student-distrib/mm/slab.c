@@ -0,0 +1,332 @@
+/**
+ * slab.c
+ *
+ * The kernel slab allocator. The part of the kernel's 4 MB page that the
+ * kernel image, the boot modules and the boot stack leave over is split into
+ * 4 KB slabs, and every slab holds objects of one size for one cache.
+ *
+ * The bookkeeping for a slab lives in a table indexed by its page, so freeing
+ * an object only needs its address. Free objects are kept on a list threaded
+ * through the objects themselves, and a new slab hands out its objects in
+ * order before it has any free list, so allocating and freeing never loop.
+ */
+
+#include "../lib.h"
+#include "slab.h"
+
+/* Check if the bit BIT in FLAGS is set. */
+#define CHECK_FLAG(flags, bit)   ((flags) & (1 << (bit)))
+
+#define PAGE_UP(x)      (((x) + SLAB_PAGE_SIZE - 1) & ~(SLAB_PAGE_SIZE - 1))
+#define PAGE_INDEX(x)   (((uint32_t)(x) - SLAB_HEAP_BASE) / SLAB_PAGE_SIZE)
+#define PAGE_ADDR(s)    (SLAB_HEAP_BASE + (uint32_t)((s) - slabs) * SLAB_PAGE_SIZE)
+
+/* the kmalloc size classes are the powers of two from 16 B to a whole page */
+#define NUM_SIZE_CLASSES    9
+#define SMALLEST_CLASS      16
+
+/**
+ * slab_t - the bookkeeping for one page of the heap.
+ *
+ *    cache - the cache the slab belongs to, NULL while the page is free
+ *    next, prev - the cache's partial list, or (next only) the free pages
+ *    free - objects that were given back
+ *    fresh - the objects from this index on were never handed out
+ *    in_use - how many objects are allocated
+ */
+typedef struct slab {
+    slab_cache_t* cache;
+    struct slab* next;
+    struct slab* prev;
+    void* free;
+    uint32_t fresh;
+    uint32_t in_use;
+} slab_t;
+
+/* the end of the kernel image, from the linker */
+extern int8_t _end;
+
+static slab_t slabs[SLAB_HEAP_PAGES];
+static uint32_t heap_start = SLAB_HEAP_PAGES; // the first page slabs may use
+static uint32_t heap_next = SLAB_HEAP_PAGES;  // the first page never used
+static slab_t* free_slabs = NULL;             // pages given back
+static uint32_t free_pages = 0;
+
+static slab_cache_t caches[SLAB_MAX_CACHES];
+static uint32_t num_caches = 0;
+static slab_cache_t* size_classes[NUM_SIZE_CLASSES];
+static const int8_t* class_names[NUM_SIZE_CLASSES] = {
+    "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128", "kmalloc-256",
+    "kmalloc-512", "kmalloc-1024", "kmalloc-2048", "kmalloc-4096"
+};
+
+/* static function declarations */
+static slab_t* get_page();
+static void put_page(slab_t* s);
+static void partial_add(slab_cache_t* cache, slab_t* s);
+static void partial_remove(slab_cache_t* cache, slab_t* s);
+
+/**
+ * slab_init()
+ *
+ * DESCRIPTION: finds the free memory between the end of the kernel (and the
+ * boot modules) and the boot stack and sets up the kmalloc size classes.
+ * INPUTS: mbi - the multiboot info structure handed to entry()
+ * OUTPUTS: none
+ */
+void slab_init(multiboot_info_t* mbi) {
+    uint32_t start = (uint32_t)&_end;
+    uint32_t i;
+
+    // GRUB puts the boot modules (the filesystem) right after the kernel
+    if (CHECK_FLAG(mbi->flags, 3)) {
+        module_t* mod = (module_t*)mbi->mods_addr;
+        for (i = 0; i < mbi->mods_count; i++, mod++) {
+            if (mod->mod_start < SLAB_HEAP_END && mod->mod_end > start)
+                start = mod->mod_end;
+        }
+    }
+
+    start = PAGE_UP(start);
+    if (start > SLAB_HEAP_END)
+        start = SLAB_HEAP_END;
+    heap_start = heap_next = PAGE_INDEX(start);
+    free_slabs = NULL;
+    free_pages = SLAB_HEAP_PAGES - heap_start;
+
+    for (i = 0; i < NUM_SIZE_CLASSES; i++) {
+        size_classes[i] = slab_cache_create(class_names[i], SMALLEST_CLASS << i);
+    }
+}
+
+/**
+ * slab_cache_create()
+ *
+ * DESCRIPTION: makes a cache for objects of one size. Caches are never
+ * destroyed, so they come out of a fixed table.
+ * INPUTS: name - what the cache holds
+ *         size - the size of one object, at most SLAB_MAX_OBJECT
+ * OUTPUTS: the cache, NULL if there is no room for another one
+ */
+slab_cache_t* slab_cache_create(const int8_t* name, uint32_t size) {
+    uint32_t flags;
+    slab_cache_t* cache;
+
+    if (size == 0 || size > SLAB_MAX_OBJECT)
+        return NULL;
+
+    cli_and_save(flags);
+    if (num_caches == SLAB_MAX_CACHES) {
+        restore_flags(flags);
+        return NULL;
+    }
+    cache = &caches[num_caches++];
+    restore_flags(flags);
+
+    strncpy(cache->name, name, SLAB_NAME_LEN - 1);
+    cache->name[SLAB_NAME_LEN - 1] = '\0';
+    cache->size = (size + SLAB_MIN_OBJECT - 1) & ~(SLAB_MIN_OBJECT - 1);
+    cache->per_slab = SLAB_PAGE_SIZE / cache->size;
+    cache->partial = NULL;
+    cache->in_use = 0;
+    return cache;
+}
+
+/**
+ * slab_alloc()
+ *
+ * DESCRIPTION: takes one object from a cache: a freed one if the first
+ * partial slab has any, else its next fresh one, else one from a new slab.
+ * INPUTS: cache - the cache to allocate from
+ * OUTPUTS: the object, NULL if there is no memory left
+ */
+void* slab_alloc(slab_cache_t* cache) {
+    uint32_t flags;
+    slab_t* s;
+    void* obj;
+
+    if (cache == NULL)
+        return NULL;
+
+    cli_and_save(flags);
+    s = cache->partial;
+    if (s == NULL) {
+        if ((s = get_page()) == NULL) {
+            restore_flags(flags);
+            return NULL;
+        }
+        s->cache = cache;
+        s->free = NULL;
+        s->fresh = 0;
+        s->in_use = 0;
+        partial_add(cache, s);
+    }
+
+    if (s->free != NULL) {
+        obj = s->free;
+        s->free = *(void**)obj;
+    } else {
+        obj = (void*)(PAGE_ADDR(s) + s->fresh * cache->size);
+        s->fresh++;
+    }
+
+    s->in_use++;
+    cache->in_use++;
+    // full slabs are not on any list until something in them is freed
+    if (s->in_use == cache->per_slab)
+        partial_remove(cache, s);
+
+    restore_flags(flags);
+    return obj;
+}
+
+/**
+ * slab_free()
+ *
+ * DESCRIPTION: gives an object from slab_alloc or kmalloc back to its cache.
+ * A slab that empties out goes back to the free pages, unless it is the only
+ * one the cache has left, which saves setting it up again on the next alloc.
+ * INPUTS: obj - the object, NULL is ignored
+ * OUTPUTS: none
+ */
+void slab_free(void* obj) {
+    uint32_t flags;
+    slab_t* s;
+    slab_cache_t* cache;
+
+    if ((uint32_t)obj < SLAB_HEAP_BASE + heap_start * SLAB_PAGE_SIZE ||
+        (uint32_t)obj >= SLAB_HEAP_END)
+        return;
+
+    cli_and_save(flags);
+    s = &slabs[PAGE_INDEX(obj)];
+    cache = s->cache;
+    if (cache == NULL || s->in_use == 0) {
+        restore_flags(flags);
+        return;
+    }
+
+    *(void**)obj = s->free;
+    s->free = obj;
+    if (s->in_use == cache->per_slab)
+        partial_add(cache, s);
+    s->in_use--;
+    cache->in_use--;
+
+    if (s->in_use == 0 && !(cache->partial == s && s->next == NULL)) {
+        partial_remove(cache, s);
+        put_page(s);
+    }
+    restore_flags(flags);
+}
+
+/**
+ * kmalloc()
+ *
+ * DESCRIPTION: allocates from the smallest size class that fits.
+ * INPUTS: size - the number of bytes wanted, at most SLAB_MAX_OBJECT
+ * OUTPUTS: the memory, NULL if there is none or size is too big
+ */
+void* kmalloc(uint32_t size) {
+    uint32_t i;
+
+    for (i = 0; i < NUM_SIZE_CLASSES; i++) {
+        if (size <= (SMALLEST_CLASS << i))
+            return slab_alloc(size_classes[i]);
+    }
+    return NULL;
+}
+
+/**
+ * kfree()
+ *
+ * DESCRIPTION: frees memory from kmalloc.
+ * INPUTS: ptr - the memory, NULL is ignored
+ * OUTPUTS: none
+ */
+void kfree(void* ptr) {
+    slab_free(ptr);
+}
+
+/**
+ * slab_free_pages()
+ *
+ * DESCRIPTION: returns how many pages are not in use by any slab.
+ */
+uint32_t slab_free_pages() {
+    return free_pages;
+}
+
+/**
+ * get_page()
+ *
+ * DESCRIPTION: takes a page for a new slab, a given back one if there is one.
+ * Interrupts must be off.
+ * INPUTS: none
+ * OUTPUTS: the page's slab, NULL if the heap is used up
+ */
+static slab_t* get_page() {
+    slab_t* s;
+
+    if (free_slabs != NULL) {
+        s = free_slabs;
+        free_slabs = s->next;
+    } else if (heap_next < SLAB_HEAP_PAGES) {
+        s = &slabs[heap_next++];
+    } else {
+        return NULL;
+    }
+
+    free_pages--;
+    return s;
+}
+
+/**
+ * put_page()
+ *
+ * DESCRIPTION: gives the page of an empty slab back. Interrupts must be off.
+ * INPUTS: s - the slab
+ * OUTPUTS: none
+ */
+static void put_page(slab_t* s) {
+    s->cache = NULL;
+    s->next = free_slabs;
+    free_slabs = s;
+    free_pages++;
+}
+
+/**
+ * partial_add()
+ *
+ * DESCRIPTION: puts a slab at the front of its cache's partial list.
+ * Interrupts must be off.
+ * INPUTS: cache - the cache
+ *         s - the slab
+ * OUTPUTS: none
+ */
+static void partial_add(slab_cache_t* cache, slab_t* s) {
+    s->prev = NULL;
+    s->next = cache->partial;
+    if (cache->partial != NULL)
+        cache->partial->prev = s;
+    cache->partial = s;
+}
+
+/**
+ * partial_remove()
+ *
+ * DESCRIPTION: takes a slab off its cache's partial list. Interrupts must be
+ * off.
+ * INPUTS: cache - the cache
+ *         s - the slab
+ * OUTPUTS: none
+ */
+static void partial_remove(slab_cache_t* cache, slab_t* s) {
+    if (s->prev != NULL)
+        s->prev->next = s->next;
+    else
+        cache->partial = s->next;
+    if (s->next != NULL)
+        s->next->prev = s->prev;
+    s->next = s->prev = NULL;
+}
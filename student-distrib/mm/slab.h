@@ -0,0 +1,107 @@
+/**
+ * slab.h
+ *
+ * Header file for the kernel slab allocator. Hands out small kernel objects
+ * out of the free part of the kernel's 4 MB page, one cache per object size.
+ */
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include "../types.h"
+#include "../multiboot.h"
+
+/* defines for the caches */
+#define SLAB_PAGE_SIZE      0x1000      // every slab is one 4 KB page
+#define SLAB_MIN_OBJECT     8           // room for the free list pointer
+#define SLAB_MAX_OBJECT     SLAB_PAGE_SIZE
+#define SLAB_MAX_CACHES     32
+#define SLAB_NAME_LEN       16
+
+/* the memory slabs are carved from, past the kernel and the boot modules */
+#define SLAB_HEAP_BASE      0x00400000  // the kernel's 4 MB page
+#define SLAB_HEAP_END       0x007F0000  // the boot stack gets the top 64 KB
+#define SLAB_HEAP_PAGES     ((SLAB_HEAP_END - SLAB_HEAP_BASE) / SLAB_PAGE_SIZE)
+
+struct slab;
+
+/**
+ * slab_cache_t - all the slabs holding objects of one size.
+ *
+ *    name - what the cache holds, for debugging
+ *    size - the size of one object, rounded up to SLAB_MIN_OBJECT
+ *    per_slab - how many objects fit in one slab
+ *    partial - the slabs with both used and free objects
+ *    in_use - how many objects are allocated right now
+ */
+typedef struct slab_cache {
+    int8_t name[SLAB_NAME_LEN];
+    uint32_t size;
+    uint32_t per_slab;
+    struct slab* partial;
+    uint32_t in_use;
+} slab_cache_t;
+
+/**
+ * slab_init()
+ *
+ * DESCRIPTION: finds the free memory between the end of the kernel (and the
+ * boot modules) and the boot stack and sets up the kmalloc size classes.
+ * INPUTS: mbi - the multiboot info structure handed to entry()
+ * OUTPUTS: none
+ */
+void slab_init(multiboot_info_t* mbi);
+
+/**
+ * slab_cache_create()
+ *
+ * DESCRIPTION: makes a cache for objects of one size.
+ * INPUTS: name - what the cache holds
+ *         size - the size of one object, at most SLAB_MAX_OBJECT
+ * OUTPUTS: the cache, NULL if there is no room for another one
+ */
+slab_cache_t* slab_cache_create(const int8_t* name, uint32_t size);
+
+/**
+ * slab_alloc()
+ *
+ * DESCRIPTION: takes one object from a cache. The contents are undefined.
+ * INPUTS: cache - the cache to allocate from
+ * OUTPUTS: the object, NULL if there is no memory left
+ */
+void* slab_alloc(slab_cache_t* cache);
+
+/**
+ * slab_free()
+ *
+ * DESCRIPTION: gives an object from slab_alloc or kmalloc back to its cache.
+ * INPUTS: obj - the object, NULL is ignored
+ * OUTPUTS: none
+ */
+void slab_free(void* obj);
+
+/**
+ * kmalloc()
+ *
+ * DESCRIPTION: allocates from the smallest size class that fits.
+ * INPUTS: size - the number of bytes wanted, at most SLAB_MAX_OBJECT
+ * OUTPUTS: the memory, NULL if there is none or size is too big
+ */
+void* kmalloc(uint32_t size);
+
+/**
+ * kfree()
+ *
+ * DESCRIPTION: frees memory from kmalloc.
+ * INPUTS: ptr - the memory, NULL is ignored
+ * OUTPUTS: none
+ */
+void kfree(void* ptr);
+
+/**
+ * slab_free_pages()
+ *
+ * DESCRIPTION: returns how many pages are not in use by any slab.
+ */
+uint32_t slab_free_pages();
+
+#endif
@@ -0,0 +1,184 @@
+/**
+ * pipe.c
+ *
+ * A file that holds the functions behind pipes: a page sized ring buffer in
+ * the kernel heap that one process writes into and another reads out of.
+ * Readers sleep while it is empty and writers while it is full, so a
+ * pipeline streams through one page no matter how much goes through it.
+ */
+
+#include "pipe.h"
+#include "lib.h"
+#include "scheduler.h"
+#include "mm/slab.h"
+
+// where the pipe structs themselves come from
+static slab_cache_t* pipe_cache = NULL;
+
+/* void init_pipes()
+ * Inputs: none
+ * Return Value: none
+ * Function: Sets up the slab cache pipes are allocated from.
+ */
+void init_pipes() {
+  pipe_cache = slab_cache_create("pipe", sizeof(pipe_t));
+}
+
+/* pipe_t* pipe_create()
+ * Inputs: none
+ * Return Value: the new pipe, NULL if there is no memory for it
+ * Function: Makes an empty pipe. The caller holds its only reader and
+ * its only writer.
+ */
+pipe_t* pipe_create() {
+  pipe_t* pipe = slab_alloc(pipe_cache);
+  if (pipe == NULL) {
+    return NULL;
+  }
+
+  pipe->buf = kmalloc(PIPE_BUF_SIZE);
+  if (pipe->buf == NULL) {
+    slab_free(pipe);
+    return NULL;
+  }
+  pipe->head = 0;
+  pipe->tail = 0;
+  pipe->readers = 1;
+  pipe->writers = 1;
+  pipe->read_queue.head = NULL;
+  pipe->write_queue.head = NULL;
+  return pipe;
+}
+
+/* void pipe_dup(pipe_t* pipe, int32_t end)
+ * Inputs: pipe - the pipe
+ *         end - PIPE_READ_END or PIPE_WRITE_END
+ * Return Value: none
+ * Function: Counts another file descriptor for one end of a pipe, such as
+ * the copy a process started on the pipe gets.
+ */
+void pipe_dup(pipe_t* pipe, int32_t end) {
+  uint32_t flags;
+  cli_and_save(flags);
+  if (end == PIPE_READ_END) {
+    pipe->readers++;
+  } else {
+    pipe->writers++;
+  }
+  restore_flags(flags);
+}
+
+/* void pipe_release(pipe_t* pipe, int32_t end)
+ * Inputs: pipe - the pipe
+ *         end - PIPE_READ_END or PIPE_WRITE_END
+ * Return Value: none
+ * Function: Drops a file descriptor for one end. Whoever waits on the other
+ * end is woken, since readers see the end of the data once every writer is
+ * gone and writers fail once every reader is. The last one out frees the pipe.
+ */
+void pipe_release(pipe_t* pipe, int32_t end) {
+  uint32_t flags;
+  cli_and_save(flags);
+  if (end == PIPE_READ_END) {
+    pipe->readers--;
+    wake_up(&pipe->write_queue);
+  } else {
+    pipe->writers--;
+    wake_up(&pipe->read_queue);
+  }
+
+  if (pipe->readers == 0 && pipe->writers == 0) {
+    kfree(pipe->buf);
+    slab_free(pipe);
+  }
+  restore_flags(flags);
+}
+
+/*
+ * int32_t pipe_read()
+ *
+ * Inputs: fd - the read end
+ *         buf - where to put the data
+ *         nbytes - the size of buf
+ * Return Value: the number of bytes read, 0 once the pipe is empty and has
+ *               no writers left, -1 on failure
+ * Function: Waits until the pipe has data and reads as much of it as fits
+ */
+int32_t pipe_read (int32_t fd, void* buf, int32_t nbytes) {
+  pipe_t* pipe = curr_pcb->file_descs[fd].data;
+  int32_t i = 0;
+
+  if (buf == NULL || nbytes < 0) {
+    return -1;
+  }
+
+  cli();
+  while (pipe->head == pipe->tail && pipe->writers > 0) {
+    sleep_on(&pipe->read_queue);
+  }
+
+  while (i < nbytes && pipe->tail != pipe->head) {
+    ((uint8_t*)buf)[i++] = pipe->buf[pipe->tail % PIPE_BUF_SIZE];
+    pipe->tail++;
+  }
+  if (i > 0) {
+    wake_up(&pipe->write_queue);
+  }
+  sti();
+
+  return i;
+}
+
+/*
+ * int32_t pipe_write()
+ *
+ * Inputs: fd - the write end
+ *         buf - the data
+ *         nbytes - how many bytes
+ * Return Value: the number of bytes written, -1 if nobody is left to read them
+ * Function: Copies a buffer into the pipe, waiting for the readers to make
+ * room whenever it fills up
+ */
+int32_t pipe_write (int32_t fd, const void* buf, int32_t nbytes) {
+  pipe_t* pipe = curr_pcb->file_descs[fd].data;
+  int32_t i = 0;
+
+  if (buf == NULL || nbytes < 0) {
+    return -1;
+  }
+
+  cli();
+  while (i < nbytes) {
+    if (pipe->readers == 0) {
+      sti();
+      return (i > 0) ? i : -1;
+    }
+    if (pipe->head - pipe->tail == PIPE_BUF_SIZE) {
+      sleep_on(&pipe->write_queue);
+      continue;
+    }
+
+    while (i < nbytes && pipe->head - pipe->tail < PIPE_BUF_SIZE) {
+      pipe->buf[pipe->head % PIPE_BUF_SIZE] = ((const uint8_t*)buf)[i++];
+      pipe->head++;
+    }
+    wake_up(&pipe->read_queue);
+  }
+  sti();
+
+  return nbytes;
+}
+
+/*
+ * int32_t pipe_close()
+ *
+ * Inputs: fd - either end of a pipe
+ * Return Value: 0
+ * Function: Closes one end of a pipe
+ */
+int32_t pipe_close (int32_t fd) {
+  fd_entry_t* entry = &curr_pcb->file_descs[fd];
+  pipe_release(entry->data, entry->inode);
+  entry->data = NULL;
+  return 0;
+}
@@ -0,0 +1,63 @@
+/**
+ * pipe.h
+ *
+ * h file that holds definitions of functions, including all the
+ * functions in pipe.c
+ */
+#ifndef _PIPE_H
+#define _PIPE_H
+
+#include "types.h"
+#include "sys/pcb.h"
+
+/* the ends of a pipe, kept in the inode field of their file descriptors */
+#define PIPE_READ_END 0
+#define PIPE_WRITE_END 1
+
+/* a pipe holds at most one page of data, powers of two so the indexes run freely */
+#define PIPE_BUF_SIZE 4096
+
+/**
+ * pipe_t - a one page ring buffer between the two ends of a pipe.
+ *
+ *    buf - the data, PIPE_BUF_SIZE bytes from kmalloc
+ *    head - where the next byte is written
+ *    tail - where the next byte is read from
+ *    readers, writers - how many file descriptors hold each end
+ *    read_queue - processes waiting for data (or for the last writer to go)
+ *    write_queue - processes waiting for room (or for the last reader to go)
+ */
+typedef struct pipe {
+  uint8_t* buf;
+  uint32_t head;
+  uint32_t tail;
+  int32_t readers;
+  int32_t writers;
+  wait_queue_t read_queue;
+  wait_queue_t write_queue;
+} pipe_t;
+
+/* function declarations */
+
+/* Function to set up the cache pipes come from */
+void init_pipes();
+
+/* Function to make an empty pipe with one reader and one writer */
+pipe_t* pipe_create();
+
+/* Function to count one more file descriptor for an end of a pipe */
+void pipe_dup(pipe_t* pipe, int32_t end);
+
+/* Function to drop a file descriptor for an end, freeing the pipe after the last */
+void pipe_release(pipe_t* pipe, int32_t end);
+
+/* Function to read from the read end of a pipe */
+int32_t pipe_read (int32_t fd, void* buf, int32_t nbytes);
+
+/* Function to write to the write end of a pipe */
+int32_t pipe_write (int32_t fd, const void* buf, int32_t nbytes);
+
+/* Function to close either end of a pipe */
+int32_t pipe_close (int32_t fd);
+
+#endif // _PIPE_H
@@ -11,7 +11,6 @@
 #define MODE_REG  0x43
 #define MODE_HEX  0x36 // 0b00110110
 #define DATA_RATE 15906 // 1.193 MHz / 75 Hz = 15906
-#define MAX_PIT_TICKS 3 // results in a 25 Hz scheduler (40 ms per process)
 
 
 /**
@@ -67,11 +66,9 @@ void handle_pit_interrupt() {
   pit_ticks++;
   enable_irq(IRQ_PIT);
 
-  if (pit_ticks >= MAX_PIT_TICKS || curr_pcb->is_yield) { 
-    curr_pcb->is_yield = 0;
-    // perform task switching
-    scheduler_pass();
-    // int next_pid = find_next_pid();
-    // context_switch(curr_pcb->pid, next_pid);
-  }
+  // put any characters drawn since the last tick on the screen
+  flush_screens();
+
+  // let the scheduler decide whether it is time to switch
+  scheduler_tick();
 }
@@ -14,7 +14,7 @@
 /* defines to improve readability */
 
 /* global variables */
-int pit_ticks;
+int pit_ticks; // pit ticks since boot
 
 /**
  * init_pit()
@@ -11,6 +11,7 @@
 #include "lib.h"
 #include "constants.h"
 #include "sys/pcb.h"
+#include "scheduler.h"
 
 #define OUT_RTC 0x70
 #define IN_RTC 0x71
@@ -37,6 +38,9 @@
 // initialize flag to check if interrupt has occurred
 volatile uint32_t ticks;
 
+// processes in rtc_read waiting for ticks to go by
+static wait_queue_t rtc_queue;
+
 
 /* void init_rtc()
  * Inputs: none
@@ -90,6 +94,9 @@ extern void handle_rtc_interrupt() {
     ticks++;
   }
 
+  // let the readers check whether their tick has come
+  wake_up(&rtc_queue);
+
   // done handling the rtc interrupt, allow more
   enable_irq(IRQ_RTC);
 }
@@ -130,6 +137,7 @@ int32_t rtc_close (int32_t fd) {
  * Function: Reads from RTC, waits for interrupt
  */
 int32_t rtc_read (int32_t fd, void* buf, int32_t nbytes) {
+  cli();
   uint32_t curr_ticks = ticks;
   int proc_freq = curr_pcb->rtc_freq;
 
@@ -143,15 +151,16 @@ int32_t rtc_read (int32_t fd, void* buf, int32_t nbytes) {
     // What should we do in this case? We know the maximum frequency, so we can
     // hard code a loop like this until we overflow
     while (ticks > MAXUINT32 / 2) {
-      curr_pcb->is_yield = 1; // yield our time slice
+      sleep_on(&rtc_queue);
     }
   } else {
     target_ticks = curr_ticks + wanted_ticks;
   }
 
   while (ticks < target_ticks) {
-      curr_pcb->is_yield = 1; // yield our time slice
-    }
+    sleep_on(&rtc_queue);
+  }
+  sti();
 
   return 0;
 }
@@ -6,55 +6,448 @@
 #include "scheduler.h"
 #include "pit.h"
 
+/* how many pit ticks a process may run at each priority level before it is
+ * moved down a level. Higher levels (lower numbers) get shorter slices. */
+static const int level_quantum[NUM_LEVELS] = {QUANTUM_LEVEL_0, QUANTUM_LEVEL_1, QUANTUM_LEVEL_2};
+
+/**
+ * run_queue_t - the runnable processes of one priority level, in the order
+ * they get to run, linked through their pcbs' run_next
+ */
+typedef struct {
+  pcb_t* head;
+  pcb_t* tail;
+} run_queue_t;
+
+static run_queue_t run_queues[NUM_LEVELS];
+
+/* the context that runs when nothing else can, and how long it has run */
+static pcb_t* idle_pcb = NULL;
+static uint32_t idle_ticks = 0;
+static uint32_t total_ticks = 0;
+
+/* room for the cpu usage line, two 10 digit tick counts and the text */
+#define CPUSTAT_LINE_LEN 64
+
+/* static function declarations */
+static void run_queue_remove(pcb_t* pcb);
+static int highest_ready_level();
+static void boost_all();
+static void idle_loop();
+
+/**
+ * init_scheduler()
+ *
+ * DESCRIPTION: sets up the idle context. It gets a pid, kernel stack and
+ *              pcb like any process, but is never on a run queue and never
+ *              enters user space.
+ * INPUTS: none
+ * OUTPUTS: none
+ */
+void init_scheduler() {
+  idle_pcb = alloc_pcb();
+  if (idle_pcb == NULL) {
+    return;
+  }
+
+  idle_pcb->term_index = -1;
+  idle_pcb->parent_pcb = NULL;
+  idle_pcb->blocked = 0;
+  idle_pcb->wait_next = NULL;
+  idle_pcb->priority = NUM_LEVELS - 1;
+  idle_pcb->slice_ticks = 0;
+  idle_pcb->on_run_queue = 0;
+  idle_pcb->run_next = NULL;
+  idle_pcb->my_esp = 0; // context_switch starts idle_loop the first time
+  idle_pcb->my_ebp = 0;
+  idle_pcb->start = idle_loop;
+  idle_pcb->spawned = 0;
+  idle_pcb->zombie = 0;
+  setup_program_page(idle_pcb->pid);
+}
+
+/**
+ * get_cpu_ticks()
+ *
+ * DESCRIPTION: reports how many pit ticks the scheduler has seen since the
+ *              first process started, and how many of them the cpu was idle.
+ * INPUTS: idle - where to store the idle ticks
+ *         total - where to store the total ticks
+ * OUTPUTS: none
+ */
+void get_cpu_ticks(uint32_t* idle, uint32_t* total) {
+  if (idle != NULL) {
+    *idle = idle_ticks;
+  }
+  if (total != NULL) {
+    *total = total_ticks;
+  }
+}
+
+/**
+ * cpustat_open()
+ *
+ * DESCRIPTION: opens the cpu usage file, which has no entry in the file
+ *              system.
+ * INPUTS: filename - ignored
+ * OUTPUTS: 0
+ */
+int32_t cpustat_open(const uint8_t* filename) {
+  return 0;
+}
+
+/**
+ * cpustat_close()
+ *
+ * DESCRIPTION: closes the cpu usage file.
+ * INPUTS: fd - ignored
+ * OUTPUTS: 0
+ */
+int32_t cpustat_close(int32_t fd) {
+  return 0;
+}
+
+/**
+ * cpustat_read()
+ *
+ * DESCRIPTION: reads the cpu usage file, one line such as
+ *              "idle 900 of 1000 ticks, 10% busy". The line is made again on
+ *              every read, so reopen the file for fresh numbers.
+ * INPUTS: fd - the file descriptor, its position is where the read starts
+ *         buf - where to put the text
+ *         nbytes - the size of buf
+ * OUTPUTS: the number of bytes read, 0 at the end of the line
+ */
+int32_t cpustat_read(int32_t fd, void* buf, int32_t nbytes) {
+  int8_t line[CPUSTAT_LINE_LEN];
+  uint32_t idle, total, busy, len;
+  uint32_t pos = curr_pcb->file_descs[fd].file_position;
+
+  if (buf == NULL || nbytes < 0) {
+    return -1;
+  }
+
+  get_cpu_ticks(&idle, &total);
+  // the percentage without multiplying a large tick count by 100
+  busy = total - idle;
+  busy = (total < 100) ? (total ? busy * 100 / total : 0) : busy / (total / 100);
+  if (busy > 100) {
+    busy = 100;
+  }
+
+  strcpy(line, "idle ");
+  itoa(idle, line + strlen(line), 10);
+  strcpy(line + strlen(line), " of ");
+  itoa(total, line + strlen(line), 10);
+  strcpy(line + strlen(line), " ticks, ");
+  itoa(busy, line + strlen(line), 10);
+  strcpy(line + strlen(line), "% busy\n");
+
+  len = strlen(line);
+  if (pos >= len) {
+    return 0;
+  }
+  if (nbytes > len - pos) {
+    nbytes = len - pos;
+  }
+  memcpy(buf, line + pos, nbytes);
+  curr_pcb->file_descs[fd].file_position += nbytes;
+  return nbytes;
+}
+
+/**
+ * cpustat_write()
+ *
+ * DESCRIPTION: the cpu usage file is read only.
+ * INPUTS: ignored
+ * OUTPUTS: -1
+ */
+int32_t cpustat_write(int32_t fd, const void* buf, int32_t nbytes) {
+  return -1;
+}
+
+/**
+ * scheduler_tick()
+ *
+ * DESCRIPTION: charges a pit tick to the current process and switches away
+ *              from it if it used up its slice or a process of a higher
+ *              priority level is waiting. Called from the pit handler.
+ * INPUTS: none
+ * OUTPUTS: none
+ */
+void scheduler_tick() {
+  pcb_t* me = curr_pcb;
+
+  // nothing is scheduled before the first shell starts
+  if (me->pid < 0) {
+    return;
+  }
+
+  total_ticks++;
+  if (me == idle_pcb) {
+    idle_ticks++;
+  }
+
+  // every so often everybody goes back to the top so nothing starves
+  if (pit_ticks % BOOST_PERIOD == 0) {
+    boost_all();
+  }
+
+  if (me->blocked || me == idle_pcb) {
+    // nothing useful is running, hand the cpu to whoever became runnable
+    if (highest_ready_level() >= 0) {
+      scheduler_pass();
+    }
+    return;
+  }
+
+  me->slice_ticks++;
+  if (me->slice_ticks >= level_quantum[me->priority]) {
+    // used its whole slice, so it looks cpu bound: move it down a level
+    if (me->priority < NUM_LEVELS - 1) {
+      me->priority++;
+    }
+    me->slice_ticks = 0;
+    scheduler_pass();
+  } else {
+    int level = highest_ready_level();
+    if (level >= 0 && level < me->priority) {
+      scheduler_pass();
+    }
+  }
+}
+
 /**
  * scheduler_pass()
- * 
- * DESCRIPTION: passes control from the current process to the next.
+ *
+ * DESCRIPTION: passes control from the current process to the next one on
+ *              the run queues. The current process goes to the back of its
+ *              level if it can still run.
  * INPUTS: none
  * OUTPUTS: none
  */
 void scheduler_pass() {
-  // reset the pit's counter
-  pit_ticks = 0;
+  if (curr_pcb->pid >= 0 && curr_pcb != idle_pcb && !curr_pcb->blocked) {
+    run_queue_add(curr_pcb);
+  }
 
-  // perform a context switch
+  // perform a context switch (nothing happens if we picked ourselves). If
+  // nothing is runnable, we were not either, so the idle context runs.
   int next_pid = find_next_pid();
+  if (next_pid < 0 && idle_pcb != NULL) {
+    next_pid = idle_pcb->pid;
+  }
   context_switch(curr_pcb->pid, next_pid);
 }
 
 /**
  * find_next_pid()
  *
- * DESCRIPTION: finds the next process to switch to and and continue executing
+ * DESCRIPTION: takes the process that should run next off the run queues:
+ *              the first one on the highest non-empty priority level.
  * INPUTS: NONE
- * OUTPUTS: -1 - if unsuccessful
+ * OUTPUTS: -1 - if nothing is runnable
  *          int - the number of the next process to switch to
  */
 int find_next_pid() {
-  // no next pid if only one terminal is open
-  int i, count;
-  for (i = 0, count = 0; i < MAX_TERMS; i++) {
-    count += terminal[i].is_started;
+  uint32_t flags;
+  int level = highest_ready_level();
+  if (level < 0) {
+    return -1;
   }
 
-  if (count <= 1) {
-    return -1;
+  cli_and_save(flags);
+  pcb_t* next = run_queues[level].head;
+  run_queues[level].head = next->run_next;
+  if (run_queues[level].head == NULL) {
+    run_queues[level].tail = NULL;
   }
+  next->run_next = NULL;
+  next->on_run_queue = 0;
+  restore_flags(flags);
 
-  // find the next pid (the next terminal's bottom most proc)
-  int next_term = (curr_pcb->term_index + 1) % MAX_TERMS;
-  // make sure the next terminal we found is running
-  while (terminal[next_term].is_started == 0) {
-    next_term = (next_term + 1) % MAX_TERMS;
+  return next->pid;
+}
+
+/**
+ * run_queue_add()
+ *
+ * DESCRIPTION: puts a runnable process at the back of its priority level.
+ * INPUTS: pcb - the process to add
+ * OUTPUTS: none
+ */
+void run_queue_add(pcb_t* pcb) {
+  uint32_t flags;
+  if (pcb == NULL || pcb->pid < 0 || pcb == idle_pcb) {
+    return;
   }
 
-  // sanity check to make sure that terminal doesn't have a null pcb
-  if (terminal_pcbs[next_term] == NULL) {
-    return -1;
+  cli_and_save(flags);
+  if (!pcb->on_run_queue) {
+    run_queue_t* queue = &run_queues[pcb->priority];
+    pcb->run_next = NULL;
+    if (queue->tail == NULL) {
+      queue->head = pcb;
+    } else {
+      queue->tail->run_next = pcb;
+    }
+    queue->tail = pcb;
+    pcb->on_run_queue = 1;
+  }
+  restore_flags(flags);
+}
+
+/**
+ * sleep_on()
+ *
+ * DESCRIPTION: blocks the current process on a wait queue until wake_up is
+ *              called on it, running other processes in the meantime. Must be
+ *              called with interrupts off, and returns with them still off.
+ *              Wakeups can be spurious, so callers loop on their condition.
+ * INPUTS: queue - the wait queue to sleep on
+ * OUTPUTS: none
+ */
+void sleep_on(wait_queue_t* queue) {
+  pcb_t* me = curr_pcb;
+  me->blocked = 1;
+  me->wait_next = queue->head;
+  queue->head = me;
+
+  // giving up the cpu before the slice is over looks interactive, so move
+  // up a level
+  if (me->slice_ticks < level_quantum[me->priority] && me->priority > 0) {
+    me->priority--;
+  }
+  me->slice_ticks = 0;
+
+  // give the cpu to someone who can use it (the idle context if nobody can).
+  // We come back here once we have been woken and the scheduler picks us.
+  while (me->blocked) {
+    scheduler_pass();
+    cli();
   }
+}
 
-  // return the next pid the scheduler wants to switch to
-  return terminal_pcbs[next_term]->pid;
+/**
+ * wake_up()
+ *
+ * DESCRIPTION: makes every process sleeping on a wait queue runnable again.
+ *              Safe to call from an interrupt handler.
+ * INPUTS: queue - the wait queue to empty
+ * OUTPUTS: none
+ */
+void wake_up(wait_queue_t* queue) {
+  uint32_t flags;
+  cli_and_save(flags);
+  pcb_t* pcb = queue->head;
+  while (pcb != NULL) {
+    pcb_t* next = pcb->wait_next;
+    pcb->wait_next = NULL;
+    pcb->blocked = 0;
+    run_queue_add(pcb);
+    pcb = next;
+  }
+  queue->head = NULL;
+  restore_flags(flags);
+}
+
+/**
+ * run_queue_remove()
+ *
+ * DESCRIPTION: takes a process off its run queue, if it is on one.
+ * INPUTS: pcb - the process to remove
+ * OUTPUTS: none
+ */
+static void run_queue_remove(pcb_t* pcb) {
+  uint32_t flags;
+  cli_and_save(flags);
+  if (pcb->on_run_queue) {
+    run_queue_t* queue = &run_queues[pcb->priority];
+    pcb_t* prev = NULL;
+    pcb_t* curr = queue->head;
+    while (curr != NULL && curr != pcb) {
+      prev = curr;
+      curr = curr->run_next;
+    }
+    if (curr != NULL) {
+      if (prev == NULL) {
+        queue->head = pcb->run_next;
+      } else {
+        prev->run_next = pcb->run_next;
+      }
+      if (queue->tail == pcb) {
+        queue->tail = prev;
+      }
+    }
+    pcb->run_next = NULL;
+    pcb->on_run_queue = 0;
+  }
+  restore_flags(flags);
+}
+
+/**
+ * idle_loop()
+ *
+ * DESCRIPTION: what the idle context runs. Halts the cpu until an interrupt,
+ *              then hands the cpu over right away if it made anyone runnable.
+ * INPUTS: none
+ * OUTPUTS: none, never returns
+ */
+static void idle_loop() {
+  while (1) {
+    cli();
+    if (highest_ready_level() >= 0) {
+      scheduler_pass();
+    } else {
+      // sti only takes effect after the next instruction, so an interrupt
+      // can't slip in between the check and the hlt
+      asm volatile ("sti; hlt" : : : "memory");
+    }
+  }
+}
+
+/**
+ * highest_ready_level()
+ *
+ * DESCRIPTION: finds the highest priority level with a runnable process.
+ * INPUTS: none
+ * OUTPUTS: the level, -1 if every run queue is empty
+ */
+static int highest_ready_level() {
+  int level;
+  for (level = 0; level < NUM_LEVELS; level++) {
+    if (run_queues[level].head != NULL) {
+      return level;
+    }
+  }
+  return -1;
+}
+
+/**
+ * boost_all()
+ *
+ * DESCRIPTION: moves every process back to the top priority level.
+ * INPUTS: none
+ * OUTPUTS: none
+ */
+static void boost_all() {
+  uint32_t flags;
+  int level;
+  cli_and_save(flags);
+  for (level = 1; level < NUM_LEVELS; level++) {
+    while (run_queues[level].head != NULL) {
+      pcb_t* pcb = run_queues[level].head;
+      run_queue_remove(pcb);
+      pcb->priority = 0;
+      pcb->slice_ticks = 0;
+      run_queue_add(pcb);
+    }
+  }
+  if (curr_pcb->pid >= 0) {
+    curr_pcb->priority = 0;
+    curr_pcb->slice_ticks = 0;
+  }
+  restore_flags(flags);
 }
 
 /**
@@ -76,26 +469,16 @@ void context_switch(int pid_from, int pid_to) {
     return; // also don't do anything
   }
 
-  pcb_t* pcb_from;
-  pcb_t* pcb_to;
-
-  // do math to get the pcb pointers
-  if (pid_from == -1) {
-    pcb_from = &root_pcb;
-  } else {
-    pcb_from = (pcb_t*) (EIGHT_MB - (pid_from + 1) * EIGHT_KB);
-  }
-
-  if (pid_to == -1) {
-    pcb_to = &root_pcb;
-  } else {
-    pcb_to = (pcb_t*) (EIGHT_MB - (pid_to + 1) * EIGHT_KB);
+  pcb_t* pcb_from = (pid_from == -1) ? &root_pcb : get_pcb(pid_from);
+  pcb_t* pcb_to = (pid_to == -1) ? &root_pcb : get_pcb(pid_to);
+  if (pcb_from == NULL || pcb_to == NULL) {
+    return;
   }
 
-  if (pid_to > -1) {
-    // switch the program page
-    int32_t phys_addr = EIGHT_MB + (pid_to * FOUR_MB);
-    add_program_page((void*)phys_addr, 1);
+  // switch address spaces, the kernel's pages are global and stay cached.
+  // The idle context only uses kernel pages, so it keeps whatever is loaded.
+  if (pcb_to != idle_pcb) {
+    switch_page_directory(pid_to);
   }
 
   // update current_pcb
@@ -103,7 +486,7 @@ void context_switch(int pid_from, int pid_to) {
 
   // change the relevant variables in the TSS
   tss.ss0 = KERNEL_DS;
-  tss.esp0 = EIGHT_MB - (pid_to * EIGHT_KB) - 4;
+  tss.esp0 = pcb_to->kstack_top;
 
 
   // save the esp and ebp
@@ -116,15 +499,28 @@ void context_switch(int pid_from, int pid_to) {
     : "=m" (pcb_from->my_esp), "=m"(pcb_from->my_ebp)
   );
 
+  // the idle context (or a spawned process) has never run the first time we
+  // switch to it, so there is nothing to restore. Start it at the top of its
+  // stack instead.
+  if (pcb_to->my_esp == 0) {
+    asm volatile (
+      "cli;"
+      "movl %0, %%esp;"
+      "xorl %%ebp, %%ebp;"
+      "call *%1;"
+      :
+      : "r" (pcb_to->kstack_top), "r" (pcb_to->start)
+      : "memory"
+    );
+  }
+
   asm volatile (
     "cli;"
     "movl %0, %%esp;"
     "movl %1, %%ebp;"
-    "movl %%cr3, %%eax;"
-    "movl %%eax, %%cr3;" // flush the tlb
     "sti;"
     :
     :"m" (pcb_to->my_esp), "m"(pcb_to->my_ebp)
-    :"memory", "%eax"
+    :"memory"
   );
 }
@@ -11,10 +11,95 @@
 #include "sys/pcb.h"
 #include "terminal.h"
 
+/* the multilevel feedback queue. Level 0 is the highest priority. New and
+ * interactive processes start near the top and get short slices, processes
+ * that keep using their whole slice sink to the longer slices below */
+#define NUM_LEVELS        3
+#define QUANTUM_LEVEL_0   1   // pit ticks (13.3 ms each)
+#define QUANTUM_LEVEL_1   3
+#define QUANTUM_LEVEL_2   6
+#define BOOST_PERIOD      75  // pit ticks between moving everyone back to the top
+
+/**
+ * init_scheduler()
+ *
+ * DESCRIPTION: sets up the idle context, which runs whenever no process can.
+ * INPUTS: none
+ * OUTPUTS: none
+ */
+void init_scheduler();
+
+/**
+ * get_cpu_ticks()
+ *
+ * DESCRIPTION: reports how many pit ticks the scheduler has seen since the
+ *              first process started, and how many of them the cpu was idle.
+ * INPUTS: idle - where to store the idle ticks
+ *         total - where to store the total ticks
+ * OUTPUTS: none
+ */
+void get_cpu_ticks(uint32_t* idle, uint32_t* total);
+
+/* the name the cpu usage file is opened by */
+#define CPUSTAT_NAME "cpustat"
+
+/**
+ * cpustat_open()
+ *
+ * DESCRIPTION: opens the cpu usage file, which has no entry in the file
+ *              system.
+ * INPUTS: filename - ignored
+ * OUTPUTS: 0
+ */
+int32_t cpustat_open(const uint8_t* filename);
+
+/**
+ * cpustat_close()
+ *
+ * DESCRIPTION: closes the cpu usage file.
+ * INPUTS: fd - ignored
+ * OUTPUTS: 0
+ */
+int32_t cpustat_close(int32_t fd);
+
+/**
+ * cpustat_read()
+ *
+ * DESCRIPTION: reads the cpu usage file, one line with the idle and total
+ *              ticks from get_cpu_ticks and the share the cpu was busy.
+ * INPUTS: fd - the file descriptor, its position is where the read starts
+ *         buf - where to put the text
+ *         nbytes - the size of buf
+ * OUTPUTS: the number of bytes read, 0 at the end of the line
+ */
+int32_t cpustat_read(int32_t fd, void* buf, int32_t nbytes);
+
+/**
+ * cpustat_write()
+ *
+ * DESCRIPTION: the cpu usage file is read only.
+ * INPUTS: ignored
+ * OUTPUTS: -1
+ */
+int32_t cpustat_write(int32_t fd, const void* buf, int32_t nbytes);
+
+/**
+ * scheduler_tick()
+ *
+ * DESCRIPTION: charges a pit tick to the current process and switches away
+ *              from it if it used up its slice or a process of a higher
+ *              priority level is waiting. Called from the pit handler.
+ * INPUTS: none
+ * OUTPUTS: none
+ */
+void scheduler_tick();
+
 /**
  * scheduler_pass()
- * 
- * DESCRIPTION: passes control from the current process to the next.
+ *
+ * DESCRIPTION: passes control from the current process to the next one on
+ *              the run queues. The current process goes to the back of its
+ *              level if it can still run.
  * INPUTS: none
  * OUTPUTS: none
  */
@@ -23,13 +108,45 @@ void scheduler_pass();
 /**
  * find_next_pid()
  *
- * DESCRIPTION: finds the next process to switch to and and continue executing
+ * DESCRIPTION: takes the process that should run next off the run queues:
+ *              the first one on the highest non-empty priority level.
  * INPUTS: NONE
- * OUTPUTS: -1 - if unsuccessful
+ * OUTPUTS: -1 - if nothing is runnable
  *          int - the number of the next process to switch to
  */
 int find_next_pid();
 
+/**
+ * run_queue_add()
+ *
+ * DESCRIPTION: puts a runnable process at the back of its priority level.
+ * INPUTS: pcb - the process to add
+ * OUTPUTS: none
+ */
+void run_queue_add(pcb_t* pcb);
+
+/**
+ * sleep_on()
+ *
+ * DESCRIPTION: blocks the current process on a wait queue until wake_up is
+ *              called on it, running other processes in the meantime. Must be
+ *              called with interrupts off, and returns with them still off.
+ *              Wakeups can be spurious, so callers loop on their condition.
+ * INPUTS: queue - the wait queue to sleep on
+ * OUTPUTS: none
+ */
+void sleep_on(wait_queue_t* queue);
+
+/**
+ * wake_up()
+ *
+ * DESCRIPTION: makes every process sleeping on a wait queue runnable again.
+ *              Safe to call from an interrupt handler.
+ * INPUTS: queue - the wait queue to empty
+ * OUTPUTS: none
+ */
+void wake_up(wait_queue_t* queue);
+
 /**
  * context_switch(int pid_from, int pid_to)
  *
@@ -0,0 +1,357 @@
+/**
+ * serial.c
+ *
+ * A file that holds functions that help initialize
+ * and handle interrupts from the COM1 serial port (a 16550 uart).
+ */
+
+#include "serial.h"
+#include "i8259.h"
+#include "lib.h"
+#include "scheduler.h"
+#include "constants.h"
+
+#define COM1_PORT 0x3F8
+#define DATA_REG (COM1_PORT + 0)      /* rx/tx holding register */
+#define INT_ENABLE_REG (COM1_PORT + 1)
+#define DIVISOR_LOW (COM1_PORT + 0)   /* while DLAB is set */
+#define DIVISOR_HIGH (COM1_PORT + 1)
+#define INT_ID_REG (COM1_PORT + 2)    /* reads */
+#define FIFO_CTRL_REG (COM1_PORT + 2) /* writes */
+#define LINE_CTRL_REG (COM1_PORT + 3)
+#define MODEM_CTRL_REG (COM1_PORT + 4)
+#define LINE_STATUS_REG (COM1_PORT + 5)
+#define MODEM_STATUS_REG (COM1_PORT + 6)
+
+#define BAUD_DIVISOR 1       /* 115200 baud */
+#define LINE_8N1 0x03        /* 8 data bits, no parity, 1 stop bit */
+#define LINE_DLAB 0x80
+#define FIFO_ENABLE 0xC7     /* enable and clear the fifos, rx irq at 14 bytes */
+#define MODEM_READY 0x0B     /* DTR, RTS and OUT2 (which gates the irq line) */
+#define MODEM_LOOPBACK 0x1E  /* loopback for the self test */
+#define LOOPBACK_BYTE 0xAE
+
+#define INT_RX 0x01          /* data received */
+#define INT_TX 0x02          /* transmit holding register empty */
+
+#define IIR_NONE 0x01        /* no interrupt pending */
+#define IIR_ID_MASK 0x0E
+#define IIR_LINE_STATUS 0x06
+#define IIR_RX_DATA 0x04
+#define IIR_RX_TIMEOUT 0x0C
+#define IIR_TX_EMPTY 0x02
+
+#define LSR_DATA_READY 0x01
+#define LSR_TX_EMPTY 0x20
+
+#define TX_FIFO_SIZE 16
+#define TX_BUF_SIZE 4096     /* powers of two, the indexes run freely */
+#define RX_BUF_SIZE 256
+
+#define BACKSPACE 0x08
+#define DELETE 0x7F
+
+// whether there is a uart at COM1 at all
+static int serial_present = 0;
+
+// bytes waiting to go out. The irq only moves tx_tail, everyone else only
+// moves tx_head, and both with interrupts off.
+static uint8_t tx_buf[TX_BUF_SIZE];
+static uint32_t tx_head = 0;
+static uint32_t tx_tail = 0;
+static int tx_running = 0;
+
+// bytes received, and how many complete lines are among them
+static uint8_t rx_buf[RX_BUF_SIZE];
+static uint32_t rx_head = 0;
+static uint32_t rx_tail = 0;
+static uint32_t rx_lines = 0;
+
+// processes waiting for room to send or for a line to read
+static wait_queue_t tx_queue;
+static wait_queue_t rx_queue;
+
+/* void fill_tx_fifo()
+ * Inputs: none
+ * Return Value: none
+ * Function: Moves up to a fifo's worth of bytes to the uart and turns the
+ * transmit interrupt off once there is nothing left. Interrupts must be off.
+ */
+static void fill_tx_fifo() {
+  int i;
+  for (i = 0; i < TX_FIFO_SIZE && tx_tail != tx_head; i++) {
+    outb(tx_buf[tx_tail % TX_BUF_SIZE], DATA_REG);
+    tx_tail++;
+  }
+
+  if (tx_tail == tx_head) {
+    tx_running = 0;
+    outb(INT_RX, INT_ENABLE_REG);
+  }
+  wake_up(&tx_queue);
+}
+
+/* void start_tx()
+ * Inputs: none
+ * Return Value: none
+ * Function: Kicks the transmitter if it went idle. The first fifo's worth
+ * goes out right away, the interrupt sends the rest. Interrupts must be off.
+ */
+static void start_tx() {
+  if (tx_running || tx_tail == tx_head) {
+    return;
+  }
+  tx_running = 1;
+  outb(INT_RX | INT_TX, INT_ENABLE_REG);
+  if (inb(LINE_STATUS_REG) & LSR_TX_EMPTY) {
+    fill_tx_fifo();
+  }
+}
+
+/* int32_t tx_queue_byte(uint8_t c)
+ * Inputs: c - the byte to send
+ * Return Value: 0 if queued, -1 if the buffer is full
+ * Function: Adds a byte to the transmit buffer, a newline as "\r\n".
+ * Interrupts must be off.
+ */
+static int32_t tx_queue_byte(uint8_t c) {
+  if (c == '\n') {
+    if (tx_head - tx_tail > TX_BUF_SIZE - 2) {
+      return -1;
+    }
+    tx_buf[tx_head % TX_BUF_SIZE] = '\r';
+    tx_head++;
+  } else if (tx_head - tx_tail == TX_BUF_SIZE) {
+    return -1;
+  }
+  tx_buf[tx_head % TX_BUF_SIZE] = c;
+  tx_head++;
+  return 0;
+}
+
+/* void receive_byte(uint8_t c)
+ * Inputs: c - the byte that came in
+ * Return Value: none
+ * Function: Line discipline for the serial terminal: echoes the byte back,
+ * handles backspace and wakes up readers once a line is complete.
+ */
+static void receive_byte(uint8_t c) {
+  if (c == '\r') {
+    c = '\n';
+  }
+
+  if (c == BACKSPACE || c == DELETE) {
+    // only the line being typed can be taken back
+    if (rx_head != rx_tail && rx_buf[(rx_head - 1) % RX_BUF_SIZE] != '\n') {
+      rx_head--;
+      tx_queue_byte(BACKSPACE);
+      tx_queue_byte(' ');
+      tx_queue_byte(BACKSPACE);
+    }
+  } else if (rx_head - rx_tail < RX_BUF_SIZE) {
+    rx_buf[rx_head % RX_BUF_SIZE] = c;
+    rx_head++;
+    tx_queue_byte(c);
+    if (c == '\n') {
+      rx_lines++;
+    }
+  }
+
+  // a full buffer is handed out like a line so it can drain
+  if (rx_lines > 0 || rx_head - rx_tail == RX_BUF_SIZE) {
+    wake_up(&rx_queue);
+  }
+  start_tx();
+}
+
+/* void init_serial()
+ * Inputs: none
+ * Return Value: none
+ * Function: Initializes the uart on COM1 for 115200 8N1 with its fifos,
+ * after checking in loopback mode that there is one.
+ */
+extern void init_serial() {
+  disable_irq(IRQ_SERIAL);
+
+  /* no uart interrupts while we set it up */
+  outb(0x00, INT_ENABLE_REG);
+
+  /* set the baud rate through the divisor latch, then the line format */
+  outb(LINE_DLAB, LINE_CTRL_REG);
+  outb(BAUD_DIVISOR & LO_BYTE_MASK, DIVISOR_LOW);
+  outb((BAUD_DIVISOR & HI_BYTE_MASK) >> BYTE_SIZE, DIVISOR_HIGH);
+  outb(LINE_8N1, LINE_CTRL_REG);
+  outb(FIFO_ENABLE, FIFO_CTRL_REG);
+
+  /* a byte sent in loopback mode has to come straight back */
+  outb(MODEM_LOOPBACK, MODEM_CTRL_REG);
+  outb(LOOPBACK_BYTE, DATA_REG);
+  if (inb(DATA_REG) != LOOPBACK_BYTE) {
+    return;
+  }
+  serial_present = 1;
+
+  /* back to normal operation, only receive interrupts until we send */
+  outb(MODEM_READY, MODEM_CTRL_REG);
+  outb(INT_RX, INT_ENABLE_REG);
+
+  enable_irq(IRQ_SERIAL);
+}
+
+/* void handle_serial_interrupt()
+ * Inputs: none
+ * Return Value: none
+ * Function: Function to handle serial interrupt. Handles everything the
+ * uart has pending: received bytes and an empty transmit fifo.
+ */
+extern void handle_serial_interrupt() {
+  uint8_t id;
+
+  disable_irq(IRQ_SERIAL);
+  send_eoi(IRQ_SERIAL);
+
+  while (!((id = inb(INT_ID_REG)) & IIR_NONE)) {
+    switch (id & IIR_ID_MASK) {
+      case IIR_LINE_STATUS:
+        inb(LINE_STATUS_REG);
+        break;
+      case IIR_RX_DATA:
+      case IIR_RX_TIMEOUT:
+        while (inb(LINE_STATUS_REG) & LSR_DATA_READY) {
+          receive_byte(inb(DATA_REG));
+        }
+        break;
+      case IIR_TX_EMPTY:
+        fill_tx_fifo();
+        break;
+      default:
+        inb(MODEM_STATUS_REG);
+        break;
+    }
+  }
+
+  enable_irq(IRQ_SERIAL);
+}
+
+/*
+ * void serial_log()
+ *
+ * Inputs: buf - the bytes to send
+ *         n - how many
+ * Return Value: none
+ * Function: Queues kernel output (the console log) on the serial port.
+ * Safe to call anywhere, so whatever does not fit is dropped.
+ */
+void serial_log(const uint8_t* buf, int32_t n) {
+  uint32_t flags;
+  int32_t i;
+
+  if (!serial_present || buf == NULL) {
+    return;
+  }
+
+  cli_and_save(flags);
+  for (i = 0; i < n; i++) {
+    if (tx_queue_byte(buf[i]) < 0) {
+      break;
+    }
+  }
+  start_tx();
+  restore_flags(flags);
+}
+
+/*
+ * int32_t serial_tx_pending()
+ *
+ * Inputs: none
+ * Return Value: the number of bytes the uart has not been given yet
+ * Function: Reports how full the transmit buffer is
+ */
+int32_t serial_tx_pending() {
+  return tx_head - tx_tail;
+}
+
+/*
+ * int32_t serial_open()
+ *
+ * Inputs: none
+ * Return Value: 0 on success, -1 if there is no serial port
+ * Function: Opens the serial port
+ */
+int32_t serial_open (const uint8_t* filename) {
+  return serial_present ? 0 : -1;
+}
+
+/*
+ * int32_t serial_close()
+ *
+ * Inputs: none
+ * Return Value: 0
+ * Function: Closes the serial port
+ */
+int32_t serial_close (int32_t fd) {
+  return 0;
+}
+
+/*
+ * int32_t serial_read()
+ *
+ * Inputs: buf - where to put the line
+ *         nbytes - the size of buf
+ * Return Value: the number of bytes read
+ * Function: Waits for a line to come in and reads (as much as fits of) it
+ */
+int32_t serial_read (int32_t fd, void* buf, int32_t nbytes) {
+  int32_t i = 0;
+
+  if (buf == NULL || nbytes < 0) {
+    return -1;
+  }
+
+  cli();
+  while (rx_lines == 0 && rx_head - rx_tail < RX_BUF_SIZE) {
+    sleep_on(&rx_queue);
+  }
+
+  while (i < nbytes && rx_tail != rx_head) {
+    uint8_t c = rx_buf[rx_tail % RX_BUF_SIZE];
+    rx_tail++;
+    ((uint8_t*)buf)[i++] = c;
+    if (c == '\n') {
+      rx_lines--;
+      break;
+    }
+  }
+  sti();
+
+  return i;
+}
+
+/*
+ * int32_t serial_write()
+ *
+ * Inputs: buf - the bytes to send
+ *         nbytes - how many
+ * Return Value: the number of bytes written, -1 on failure
+ * Function: Sends a buffer over the serial port, waiting for the transmit
+ * buffer to drain when it fills up
+ */
+int32_t serial_write (int32_t fd, const void* buf, int32_t nbytes) {
+  int32_t i;
+
+  if (buf == NULL || nbytes < 0) {
+    return -1;
+  }
+
+  cli();
+  for (i = 0; i < nbytes; i++) {
+    while (tx_queue_byte(((const uint8_t*)buf)[i]) < 0) {
+      start_tx();
+      sleep_on(&tx_queue);
+    }
+  }
+  start_tx();
+  sti();
+
+  return nbytes;
+}
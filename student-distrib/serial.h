@@ -0,0 +1,43 @@
+/**
+ * serial.h
+ *
+ * h file that holds definitions of functions, including all the
+ * functions in serial.c
+ */
+#ifndef _SERIAL_H
+#define _SERIAL_H
+
+#include "x86_desc.h"
+#include "bootinit/idt.h"
+#include "linkage.h"
+
+/* the name the serial port is opened by */
+#define SERIAL_NAME "serial"
+
+/* function declarations */
+
+/* Function to initialize the COM1 uart */
+extern void init_serial();
+
+/* Function to handle serial interrupt */
+extern void handle_serial_interrupt();
+
+/* Function to queue kernel output on the serial port, never blocks */
+void serial_log(const uint8_t* buf, int32_t n);
+
+/* Function to find out how many bytes are still waiting to be sent */
+int32_t serial_tx_pending();
+
+/* Function to open the serial port */
+int32_t serial_open (const uint8_t* filename);
+
+/* Function to close the serial port */
+int32_t serial_close (int32_t fd);
+
+/* Function to read a line received on the serial port */
+int32_t serial_read (int32_t fd, void* buf, int32_t nbytes);
+
+/* Function to send a buffer over the serial port */
+int32_t serial_write (int32_t fd, const void* buf, int32_t nbytes);
+
+#endif // _SERIAL_H
@@ -3,6 +3,15 @@
  */
 
 #include "pcb.h"
+#include "../lib.h"
+#include "../mm/slab.h"
+
+#define BITS_PER_WORD 32
+#define FULL_WORD     0xFFFFFFFF
+
+/* one bit per pid, set while the pid is in use */
+static uint32_t pid_bitmap[PID_WORDS];
+static pcb_t* pcb_table[MAX_PROCS];
 
 /**
  * init_pcb()
@@ -13,10 +22,13 @@
  * pcb structures.
  */
 void init_pcb() {
-  // instantiate the process array
+  // instantiate the pid bitmap and table
   int i;
+  for (i = 0; i < PID_WORDS; i++) {
+    pid_bitmap[i] = 0;
+  }
   for (i = 0; i < MAX_PROCS; i++) {
-    process_array[i] = 0;
+    pcb_table[i] = NULL;
   }
   // instantiate the terminal pcbs to be not started
   for (i = 0; i < MAX_TERMS; i++) {
@@ -31,7 +43,286 @@ void init_pcb() {
   root_pcb.term_index = -1;
   root_pcb.parent_esp = NULL;
   root_pcb.parent_ebp = NULL;
-  root_pcb.is_yield = 0;
+  root_pcb.blocked = 0;
+  root_pcb.wait_next = NULL;
+  root_pcb.priority = 0;
+  root_pcb.slice_ticks = 0;
+  root_pcb.on_run_queue = 0;
+  root_pcb.run_next = NULL;
+  init_fd_table(&root_pcb);
+}
+
+/**
+ * alloc_pcb()
+ *
+ * DESCRIPTION: takes a free pid and sets up the kernel stack and pcb in its
+ * slot of the kernel window.
+ * INPUTS: none
+ * OUTPUTS: the new pcb (only pid and kstack_top filled in), NULL if we are out
+ *          of pids or memory
+ */
+pcb_t* alloc_pcb() {
+  uint32_t flags;
+  int i, bit, pid = -1;
+
+  cli_and_save(flags);
+  for (i = 0; i < PID_WORDS && pid < 0; i++) {
+    if (pid_bitmap[i] == FULL_WORD)
+      continue;
+    for (bit = 0; bit < BITS_PER_WORD; bit++) {
+      if (!(pid_bitmap[i] & (1 << bit))) {
+        pid = i * BITS_PER_WORD + bit;
+        break;
+      }
+    }
+  }
+
+  if (pid < 0) {
+    restore_flags(flags);
+    return NULL;
+  }
+  pid_bitmap[pid / BITS_PER_WORD] |= (1 << (pid % BITS_PER_WORD));
+  restore_flags(flags);
+
+  // back the stack, pcb and paging structure pages (a no-op if this pid was used
+  // before). The guard page at the bottom of the slot is left alone.
+  uint32_t slot = PROC_SLOT(pid);
+  for (i = SLOT_STACK; i <= SLOT_SHM_TABLE; i++) {
+    if (map_kernel_page(slot + i * FOUR_KB) < 0) {
+      cli_and_save(flags);
+      pid_bitmap[pid / BITS_PER_WORD] &= ~(1 << (pid % BITS_PER_WORD));
+      restore_flags(flags);
+      return NULL;
+    }
+  }
+
+  pcb_t* pcb = (pcb_t*)(slot + SLOT_PCB * FOUR_KB);
+  pcb->pid = pid;
+  pcb->kstack_top = slot + SLOT_PCB * FOUR_KB - 4;
+  pcb_table[pid] = pcb;
+  return pcb;
+}
+
+/**
+ * free_pcb()
+ *
+ * DESCRIPTION: gives a pcb's pid back. The pages of its slot stay mapped for
+ * the next process to get that pid, since a halting process is still running
+ * on its kernel stack when it frees itself.
+ * INPUTS: pcb - the pcb to free
+ * OUTPUTS: none
+ */
+void free_pcb(pcb_t* pcb) {
+  if (pcb == NULL || pcb->pid < 0 || pcb->pid >= MAX_PROCS)
+    return;
+
+  uint32_t flags;
+  cli_and_save(flags);
+  pcb_table[pcb->pid] = NULL;
+  pid_bitmap[pcb->pid / BITS_PER_WORD] &= ~(1 << (pcb->pid % BITS_PER_WORD));
+  restore_flags(flags);
+}
+
+/**
+ * get_pcb()
+ *
+ * DESCRIPTION: looks up the pcb of a running process.
+ * INPUTS: pid - the process id
+ * OUTPUTS: the pcb, NULL if no process has that pid
+ */
+pcb_t* get_pcb(int pid) {
+  if (pid < 0 || pid >= MAX_PROCS)
+    return NULL;
+  return pcb_table[pid];
+}
+
+/**
+ * orphan_children()
+ *
+ * DESCRIPTION: lets go of the spawned children of a halting process. The ones
+ * that halted already are freed, the rest are reaped by reap_orphans after
+ * they halt, since nobody is left to wait for them.
+ * INPUTS: parent - the halting process
+ * OUTPUTS: none
+ */
+void orphan_children(pcb_t* parent) {
+  uint32_t flags;
+  int i;
+
+  cli_and_save(flags);
+  for (i = 0; i < MAX_PROCS; i++) {
+    pcb_t* pcb = pcb_table[i];
+    if (pcb == NULL || pcb == parent || !pcb->spawned || pcb->parent_pcb != parent)
+      continue;
+    if (pcb->zombie) {
+      free_pcb(pcb);
+      num_procs--;
+    } else {
+      pcb->parent_pcb = NULL;
+    }
+  }
+  restore_flags(flags);
+}
+
+/**
+ * reap_orphans()
+ *
+ * DESCRIPTION: frees the spawned processes that halted after their parent.
+ * A zombie is never the current process, it switched away for good when it
+ * halted.
+ * INPUTS: none
+ * OUTPUTS: none
+ */
+void reap_orphans() {
+  uint32_t flags;
+  int i;
+
+  cli_and_save(flags);
+  for (i = 0; i < MAX_PROCS; i++) {
+    pcb_t* pcb = pcb_table[i];
+    if (pcb != NULL && pcb != curr_pcb && pcb->zombie && pcb->parent_pcb == NULL) {
+      free_pcb(pcb);
+      num_procs--;
+    }
+  }
+  restore_flags(flags);
+}
+
+/**
+ * init_fd_table()
+ *
+ * DESCRIPTION: gives a pcb an empty table of MAX_FDS file descriptors.
+ * INPUTS: pcb - the pcb
+ * OUTPUTS: none
+ */
+void init_fd_table(pcb_t* pcb) {
+  int i;
+
+  pcb->file_descs = pcb->fd_inline;
+  pcb->num_fds = MAX_FDS;
+  for (i = 0; i < FD_WORDS; i++) {
+    pcb->fd_bitmap[i] = 0;
+  }
+  pcb->fd_full = 0;
+  for (i = 0; i < MAX_FDS; i++) {
+    pcb->fd_inline[i].fops_table = NULL;
+    pcb->fd_inline[i].inode = -1;
+    pcb->fd_inline[i].file_position = 0;
+    pcb->fd_inline[i].flags = FD_NOT_IN_USE;
+    pcb->fd_inline[i].data = NULL;
+  }
+}
+
+/**
+ * grow_fd_table()
+ *
+ * DESCRIPTION: doubles the size of a pcb's file descriptor table, or grows
+ * it to FD_TABLE_MAX if doubling would go past that.
+ * INPUTS: pcb - the pcb
+ * OUTPUTS: 0 if successful, -1 if it is as big as it gets or out of memory
+ */
+static int32_t grow_fd_table(pcb_t* pcb) {
+  int32_t size = pcb->num_fds * 2;
+  int32_t i;
+
+  if (pcb->num_fds >= FD_TABLE_MAX) {
+    return -1;
+  }
+  if (size > FD_TABLE_MAX) {
+    size = FD_TABLE_MAX;
+  }
+  fd_entry_t* table = kmalloc(size * sizeof(fd_entry_t));
+  if (table == NULL) {
+    return -1;
+  }
+
+  memcpy(table, pcb->file_descs, pcb->num_fds * sizeof(fd_entry_t));
+  for (i = pcb->num_fds; i < size; i++) {
+    table[i].fops_table = NULL;
+    table[i].inode = -1;
+    table[i].file_position = 0;
+    table[i].flags = FD_NOT_IN_USE;
+    table[i].data = NULL;
+  }
+
+  if (pcb->file_descs != pcb->fd_inline) {
+    kfree(pcb->file_descs);
+  }
+  pcb->file_descs = table;
+  pcb->num_fds = size;
+  return 0;
+}
+
+/**
+ * alloc_fd()
+ *
+ * DESCRIPTION: takes the lowest free file descriptor of a pcb, growing its
+ * table if every one is in use. One scan of fd_full finds the first word
+ * with a free fd and one scan of that word finds the fd, so this does not
+ * depend on how many fds are open.
+ * INPUTS: pcb - the pcb
+ * OUTPUTS: the fd, -1 if the table cannot grow any more
+ */
+int32_t alloc_fd(pcb_t* pcb) {
+  uint32_t flags;
+  int32_t word, fd;
+
+  cli_and_save(flags);
+  if (pcb->fd_full == (1 << FD_WORDS) - 1) {
+    restore_flags(flags);
+    return -1;
+  }
+  word = __builtin_ctz(~pcb->fd_full);
+  fd = word * BITS_PER_WORD + __builtin_ctz(~pcb->fd_bitmap[word]);
+
+  if (fd >= pcb->num_fds && grow_fd_table(pcb) < 0) {
+    restore_flags(flags);
+    return -1;
+  }
+
+  pcb->fd_bitmap[word] |= 1 << (fd % BITS_PER_WORD);
+  if (pcb->fd_bitmap[word] == FULL_WORD) {
+    pcb->fd_full |= 1 << word;
+  }
+  pcb->file_descs[fd].flags = FD_IN_USE;
+  restore_flags(flags);
+  return fd;
+}
+
+/**
+ * release_fd()
+ *
+ * DESCRIPTION: marks a file descriptor of a pcb free again.
+ * INPUTS: pcb - the pcb
+ *         fd - the fd
+ * OUTPUTS: none
+ */
+void release_fd(pcb_t* pcb, int32_t fd) {
+  if (fd < 0 || fd >= pcb->num_fds) {
+    return;
+  }
+
+  uint32_t flags;
+  cli_and_save(flags);
+  pcb->fd_bitmap[fd / BITS_PER_WORD] &= ~(1 << (fd % BITS_PER_WORD));
+  pcb->fd_full &= ~(1 << (fd / BITS_PER_WORD));
+  pcb->file_descs[fd].flags = FD_NOT_IN_USE;
+  restore_flags(flags);
+}
+
+/**
+ * free_fd_table()
+ *
+ * DESCRIPTION: gives a grown table back to the kernel heap and goes back to
+ * the inline one. The fds have to be closed already.
+ * INPUTS: pcb - the pcb
+ * OUTPUTS: none
+ */
+void free_fd_table(pcb_t* pcb) {
+  if (pcb->file_descs != pcb->fd_inline) {
+    kfree(pcb->file_descs);
+  }
+  init_fd_table(pcb);
 }
 
 /* define some garbage read/write/open/close functions */
@@ -5,14 +5,34 @@
 #define _PCB_H
 
 #include "../types.h"
+#include "../constants.h"
+#include "../bootinit/paging.h"
+#include "../mm/slab.h"
 
 /* defines to make our code more readable */
-#define MAX_FDS       8    // maximum number of file descriptors
+#define MAX_FDS       8    // file descriptors a process starts out with
+// the most a table grows to, as many entries as fit in one kmalloc
+#define FD_TABLE_MAX  (SLAB_MAX_OBJECT / sizeof(fd_entry_t))
+#define FD_WORDS      ((FD_TABLE_MAX + 31) / 32) // words in the fd bitmap
 #define FD_IN_USE     1
 #define FD_NOT_IN_USE 0
 #define ARG_BUF_SIZE  128  // size in characters of arg buff
-#define MAX_PROCS     6    // maximum number of processes
-#define MAX_TERMS (MAX_PROCS / 2) // each term needs to run at least 2 procs
+#define MAX_PROCS     256  // maximum number of processes
+#define MAX_TERMS     NUM_TERMS
+#define PID_WORDS     (MAX_PROCS / 32) // words in the pid bitmap
+
+/* every pid owns a PROC_SLOT_SIZE slot of the kernel window holding its kernel
+ * stack, pcb, program and shared memory page tables and page directory. The
+ * first page of a slot is never mapped, so overflowing a kernel stack faults
+ * instead of running into the slot below. MAX_PROCS slots have to fit in the
+ * window. */
+#define PROC_SLOT_SIZE    0x8000 // 32 KB
+#define PROC_SLOT(pid)    (KERNEL_WINDOW_ADDR + (pid) * PROC_SLOT_SIZE)
+#define SLOT_STACK        1      // page index of the bottom of the kernel stack
+#define SLOT_PCB          3      // the stack is the two pages below this one
+#define SLOT_PROG_TABLE   4
+#define SLOT_PAGE_DIR     5
+#define SLOT_SHM_TABLE    6
 
 /**
  * fops_t - a struct to hold the file operation jump table
@@ -38,39 +58,96 @@ typedef struct {
  *    inode - the inode number of this file
  *    file_position - the position we are in the file, initialize to 0
  *    flags - flags about the file descriptor. Currently 0 when not in use.
+ *    data - what the driver keeps for this fd (the pipe, for pipe ends)
  */
 typedef struct {
   fops_t* fops_table;
   int32_t inode;
   int32_t file_position;
   int32_t flags;
+  void* data;
 } fd_entry_t;
 
+struct _pcb;
+
+/**
+ * wait_queue_t - the processes sleeping until some event happens, linked
+ * through their pcbs' wait_next
+ */
+typedef struct {
+  struct _pcb* head;
+} wait_queue_t;
+
 /**
  * pcb_t - a struct to hold data for the pcb
  *
  * The data is:
- *    file_descs - the array of MAX_FDS file descriptors
+ *    file_descs - the file descriptor table, fd_inline until it grows
+ *    num_fds - the number of entries in file_descs
+ *    fd_bitmap - one bit per fd, set while the fd is in use
+ *    fd_full - one bit per word of fd_bitmap, set while the word is full
+ *    fd_inline - the first MAX_FDS file descriptors, inside the pcb
  *    pid - the process id of this process
+ *    exec_inode - the inode of the executable, for demand loading its pages
+ *    text_start - the first page of the program that is shared read-only
+ *    text_end - the end of the shared read-only pages (exclusive)
+ *    heap_start - the first page after the program image, where the heap starts
+ *    brk - the end of the heap (exclusive)
+ *    shm_mapped - one bit per shared memory segment we have mapped
  *    parent_pcb - a pointer to the parent pcb
  *    parent_esp - the esp to return to upon halting
  *    parent_ebp - the ebp to return to upon halting
  *    my_esp - the pcb's current esp upon leaving it's context
  *    my_ebp - the pcb's curren ebp upon leaving it's context
+ *    blocked - 1 while the process sleeps on a wait queue
+ *    wait_next - the next pcb on the wait queue we are sleeping on
+ *    priority - the scheduler level, 0 is the highest
+ *    slice_ticks - pit ticks used of the slice at this level
+ *    on_run_queue - 1 while the process waits on a run queue
+ *    run_next - the next pcb on our run queue
+ *    kstack_top - the top of this process's kernel stack (for tss.esp0)
+ *    start - where a context that never ran starts, on top of its kernel stack
+ *    entry_point - where the program starts in user space
+ *    spawned - 1 if started with spawn, so its parent waits for it with wait
+ *    zombie - 1 once a spawned process halted and waits to be reaped
+ *    exit_status - what a zombie halted with
+ *    child_exit - where we sleep in wait until a spawned child halts
  *    arg_buf - a buffer to hold the text arguments (space separated)
  */
 typedef struct _pcb {
-  fd_entry_t file_descs[MAX_FDS];
+  fd_entry_t* file_descs;
+  int32_t num_fds;
+  uint32_t fd_bitmap[FD_WORDS];
+  uint32_t fd_full;
+  fd_entry_t fd_inline[MAX_FDS];
   int pid; // the process id, 0 for first shell
+  int32_t exec_inode; // inode the program pages are loaded from
+  uint32_t text_start; // [text_start, text_end) is shared with other copies
+  uint32_t text_end;
+  uint32_t heap_start; // [heap_start, brk) is the heap
+  uint32_t brk;
+  uint32_t shm_mapped; // bit i is segment i of mm/shm.c
   int term_index; // which terminal this process is executing in
   int rtc_opened;
   uint32_t rtc_freq;
-  volatile int is_yield;
   struct _pcb* parent_pcb;
   uint32_t parent_esp;
   uint32_t parent_ebp;
   uint32_t my_esp;
   uint32_t my_ebp;
+  volatile int blocked;
+  struct _pcb* wait_next;
+  int priority;
+  int slice_ticks;
+  int on_run_queue;
+  struct _pcb* run_next;
+  uint32_t kstack_top;
+  void (*start)();
+  uint32_t entry_point;
+  int spawned;
+  volatile int zombie;
+  int32_t exit_status;
+  wait_queue_t child_exit;
   int8_t arg_buf[ARG_BUF_SIZE];
 } pcb_t;
 
@@ -79,7 +156,6 @@ pcb_t* curr_pcb; // pointer to the current pcb
 int num_procs; // the total number of running processes
 
 pcb_t root_pcb; // root of pcb tree which will hvae terminal_pcbs as children
-int process_array[MAX_PROCS]; // an array that holds the pid statuses
 pcb_t* terminal_pcbs[MAX_TERMS];
 
 
@@ -91,6 +167,95 @@ pcb_t* terminal_pcbs[MAX_TERMS];
  */
 void init_pcb();
 
+/**
+ * alloc_pcb()
+ *
+ * DESCRIPTION: takes a free pid and sets up the kernel stack and pcb in its
+ * slot of the kernel window.
+ * INPUTS: none
+ * OUTPUTS: the new pcb (only pid and kstack_top filled in), NULL if we are out
+ *          of pids or memory
+ */
+pcb_t* alloc_pcb();
+
+/**
+ * free_pcb()
+ *
+ * DESCRIPTION: gives a pcb's pid back. The pages of its slot stay mapped for
+ * the next process to get that pid, since a halting process is still running
+ * on its kernel stack when it frees itself.
+ * INPUTS: pcb - the pcb to free
+ * OUTPUTS: none
+ */
+void free_pcb(pcb_t* pcb);
+
+/**
+ * get_pcb()
+ *
+ * DESCRIPTION: looks up the pcb of a running process.
+ * INPUTS: pid - the process id
+ * OUTPUTS: the pcb, NULL if no process has that pid
+ */
+pcb_t* get_pcb(int pid);
+
+/**
+ * orphan_children()
+ *
+ * DESCRIPTION: lets go of the spawned children of a halting process. The ones
+ * that halted already are freed, the rest are reaped by reap_orphans later.
+ * INPUTS: parent - the halting process
+ * OUTPUTS: none
+ */
+void orphan_children(pcb_t* parent);
+
+/**
+ * reap_orphans()
+ *
+ * DESCRIPTION: frees the spawned processes that halted after their parent.
+ * INPUTS: none
+ * OUTPUTS: none
+ */
+void reap_orphans();
+
+/**
+ * init_fd_table()
+ *
+ * DESCRIPTION: gives a pcb an empty table of MAX_FDS file descriptors.
+ * INPUTS: pcb - the pcb
+ * OUTPUTS: none
+ */
+void init_fd_table(pcb_t* pcb);
+
+/**
+ * alloc_fd()
+ *
+ * DESCRIPTION: takes the lowest free file descriptor of a pcb, growing its
+ * table if every one is in use. Only the flags of the entry are set.
+ * INPUTS: pcb - the pcb
+ * OUTPUTS: the fd, -1 if the table cannot grow any more
+ */
+int32_t alloc_fd(pcb_t* pcb);
+
+/**
+ * release_fd()
+ *
+ * DESCRIPTION: marks a file descriptor of a pcb free again.
+ * INPUTS: pcb - the pcb
+ *         fd - the fd
+ * OUTPUTS: none
+ */
+void release_fd(pcb_t* pcb, int32_t fd);
+
+/**
+ * free_fd_table()
+ *
+ * DESCRIPTION: gives a grown table back to the kernel heap and goes back to
+ * the inline one. The fds have to be closed already.
+ * INPUTS: pcb - the pcb
+ * OUTPUTS: none
+ */
+void free_fd_table(pcb_t* pcb);
+
 /* declare some garbage operations that return -1 */
 int32_t garbage_read(int32_t fd, void* buf, int32_t nbytes);
 
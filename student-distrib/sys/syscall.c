@@ -9,30 +9,72 @@
 #include "../bootinit/paging.h"
 #include "../keyboard.h"
 #include "../rtc.h"
+#include "../serial.h"
+#include "../pipe.h"
+#include "../scheduler.h"
+#include "../mm/shm.h"
 #include "../x86_desc.h"
 #include "syscall.h"
 #include "../terminal.h"
 
-#define EIGHT_MB    0x00800000
-#define TWELVE_MB   0x00C00000
-#define FOUR_MB     0x00400000
-#define EIGHT_KB    0x00002000
 #define MB_128      0x08000000
 #define MB_132      0x08400000
 #define NEW_ESP     (MB_128 + FOUR_MB - 4)
-#define PROG_VADDR  0x08048000
 
 /* static definitions of certain file operations */
 static fops_t stdin_fops = {&terminal_read, &garbage_write, &terminal_open, &terminal_close};
 static fops_t stdout_fops = {&garbage_read, &terminal_write, &terminal_open, &terminal_close};
 static fops_t rtc_fops = {&rtc_read, &rtc_write, &rtc_open, &rtc_close};
+static fops_t serial_fops = {&serial_read, &serial_write, &serial_open, &serial_close};
+static fops_t cpustat_fops = {&cpustat_read, &cpustat_write, &cpustat_open, &cpustat_close};
 static fops_t dir_fops = {&dir_read, &dir_write, &dir_open, &dir_close};
 static fops_t file_fops = {&file_read, &file_write, &file_open, &file_close};
 static fops_t null_fops = {&garbage_read, &garbage_write, &garbage_open, &garbage_close};
+static fops_t pipe_read_fops = {&pipe_read, &garbage_write, &garbage_open, &pipe_close};
+static fops_t pipe_write_fops = {&garbage_read, &pipe_write, &garbage_open, &pipe_close};
 
 /* the magic numbers at the beginning of executables */
 static uint8_t ELF[4] = {0x7f, 0x45, 0x4c, 0x46};
 
+/* offsets and values needed to walk the ELF program headers */
+#define ELF_PHOFF       28   // offset of the program header table offset
+#define ELF_PHENTSIZE   42   // offset of the size of one program header
+#define ELF_PHNUM       44   // offset of the number of program headers
+#define ELF_MAX_PHDRS   16   // more than any of our programs have
+#define PT_LOAD         1    // a segment that is loaded into memory
+#define PF_W            0x2  // the segment is writable
+#define PAGE_SIZE       0x1000
+#define PAGE_DOWN(x)    ((x) & ~(PAGE_SIZE - 1))
+#define PAGE_UP(x)      PAGE_DOWN((x) + PAGE_SIZE - 1)
+
+/* the model specific registers SYSENTER takes its code segment, stack and
+ * entry point from, and the CPUID feature bit that says they exist */
+#define MSR_SYSENTER_CS   0x174
+#define MSR_SYSENTER_ESP  0x175
+#define MSR_SYSENTER_EIP  0x176
+#define CPUID_FEATURES    1
+#define CPUID_EDX_SEP     (1 << 11)
+
+/**
+ * elf_phdr_t - the fields of an ELF32 program header that we look at
+ */
+typedef struct {
+  uint32_t type;
+  uint32_t offset;
+  uint32_t vaddr;
+  uint32_t paddr;
+  uint32_t filesz;
+  uint32_t memsz;
+  uint32_t flags;
+  uint32_t align;
+} elf_phdr_t;
+
+static void find_shared_text(uint32_t inode, pcb_t* pcb);
+static uint32_t find_image_end(uint32_t inode);
+static pcb_t* load_program(const uint8_t* command);
+static void spawn_start();
+static void enter_user(uint32_t entry_point);
+
 /**
  * run_shell()
  *
@@ -55,8 +97,72 @@ int32_t system_execute(const uint8_t* command) {
     return -1;
   }
 
+  // spawned processes that outlived their parent give their pids back here
+  reap_orphans();
+
+  /***** 1. - 5. Load the Program and Create its PCB *****/
+  pcb_t* new_pcb = load_program(command);
+  if (new_pcb == NULL) {
+    return -1;
+  }
+
+  if (executing_initial_shell || curr_pcb == NULL) {
+    // we are executing an initial shell
+    new_pcb->parent_pcb = NULL;
+    new_pcb->term_index = visible_terminal;
+    executing_initial_shell = 0;
+  } else {
+    new_pcb->parent_pcb = curr_pcb;
+    new_pcb->term_index = curr_pcb->term_index;
+  }
+
+  // save a pointer to the old pcb
+  // pcb_t* old_pcb = curr_pcb; // should never be null
+  // set the current pcb to be the new pcb. From here on the scheduler must not
+  // run until we iret, or it would map the parent's program page back in under
+  // us, so interrupts stay off (the iret turns them back on).
+  cli();
+  curr_pcb = new_pcb;
+
+  // update the tail of the pcb list for this terminal
+  terminal_pcbs[curr_pcb->term_index] = curr_pcb;
+
+  // switch to the new address space (its program pages are still empty)
+  switch_page_directory(curr_pcb->pid);
+
+  /***** 6. Context Switch *****/
+
+  // update the tss with the kernel stack info
+  tss.ss0 = KERNEL_DS;
+  tss.esp0 = curr_pcb->kstack_top;
+
+  // save current ebp and esp
+  asm volatile(
+    "movl %%esp, %0;"
+    "movl %%ebp, %1;"
+    :"=g" (curr_pcb->parent_esp), "=g" (curr_pcb->parent_ebp) // outputs
+    : // inputs
+    : "memory" // clobbered registers
+  );
+
+  enter_user(curr_pcb->entry_point);
+
+  return -1; // we should never actually reach this specific return statment
+}
+
+/**
+ * load_program()
+ *
+ * DESCRIPTION: the part of starting a program that execute and spawn share:
+ *              parses the command, checks the executable and sets up a pcb
+ *              with paging, arguments and a stdin/stdout on the terminal for
+ *              it. The caller fills in the parent and terminal.
+ * INPUTS: command - the command and arguments to the command, space separated.
+ * OUTPUTS: the new pcb, NULL if the command cannot be run
+ */
+static pcb_t* load_program(const uint8_t* command) {
   /***** 1. Parse Command *****/
-  int8_t filename[MAX_DIRNAME_LEN];
+  int8_t filename[MAX_DIRNAME_LEN + 1]; // room for the null at full length
   int8_t arguments[MAXBUFFER];
   int32_t filename_idx = 0, space_flag = 0;
   int new_pid = -1;
@@ -77,7 +183,7 @@ int32_t system_execute(const uint8_t* command) {
   }
 
   if ((i - filename_idx) > MAX_DIRNAME_LEN) {
-    return -1; // filename too long
+    return NULL; // filename too long
   }
 
   // Initialize arguments to the empty string
@@ -87,7 +193,7 @@ int32_t system_execute(const uint8_t* command) {
   if (space_flag) {
     // copy the filename
     strncpy(filename, (int8_t*) (command + filename_idx), (i - filename_idx));
-    filename[i] = '\0'; // null terminate the filename
+    filename[i - filename_idx] = '\0'; // null terminate the filename
     i++;
 
     /* put the rest of the arguments into a different string */
@@ -102,120 +208,109 @@ int32_t system_execute(const uint8_t* command) {
   dentry_t dir_entry;
 	/* check if valid file */
   if(read_dentry_by_name((uint8_t *) filename, &dir_entry) < 0)
-		return -1;
+		return NULL;
 
   // if file is valid, check if executable by checking first 4 bytes
   uint8_t buf[4];
   read_data(dir_entry.inode_num, 0, buf, 4);
   if(buf[0] !=  ELF[0] || buf[1] != ELF[1] || buf[2] != ELF[2] || buf[3] != ELF[3])
-    return -1;
+    return NULL;
 
   /* find entry point by getting 4-byte unsigned integer in bytes 24-27 */
   read_data(dir_entry.inode_num, 24, buf, 4);
   uint32_t entry_point = *((uint32_t*)buf);
 
-  /* check PCB array for next process since
-  * we must support up to 6 in kernel */
-  for (i = 0; i < MAX_PROCS; i++) {
-    if (process_array[i] == 0) {
-      process_array[i] = 1;
-      new_pid = i;
-      break;
-    }
-  }
-
-  // make sure we found a pid available
-  if (new_pid < 0)
-    return -1;
-
+  /* take a pid, along with the kernel stack and pcb that go with it */
+  pcb_t* new_pcb = alloc_pcb();
+  if (new_pcb == NULL)
+    return NULL;
+  new_pid = new_pcb->pid;
 
   /***** 3. Set Up Program Paging *****/
   /*
    * The program image itself is linked to execute at virtual address
-	 * 0x08048000. The way to get this working is to set up a single 4 MB page
-	 * directory entry that maps virtual address 0x08000000 (128 MB) to the right
-	 * physical memory address (either 8 MB or 12 MB). Then, the program image
-	 * must be copied to the correct offset (0x00048000) within that page.
+	 * 0x08048000. The way to get this working is to set up a page table for the
+	 * 4 MB region at virtual address 0x08000000 (128 MB). Every page in it starts
+	 * out not present, and gets a physical frame from the frame allocator the
+	 * first time the program touches it.
    */
 
-  int32_t phys_addr = EIGHT_MB + (new_pid * FOUR_MB);
-  add_program_page((void*)phys_addr, 1);
+  setup_program_page(new_pid);
 
   /***** 4. User-Level Program Loader *****/
 
-	/* copy the entire file to memory starting at virtual address 0x08048000 */
-  read_data(dir_entry.inode_num, 0, (uint8_t*) PROG_VADDR, FOUR_MB);
+	/* nothing is copied here. The page fault handler loads each page of the
+	 * file at 0x08048000 from the filesystem the first time it is touched */
 
   /***** 5. Create Process Control Block (PCB) *****/
 
   // increment the number of processes
   num_procs++;
 
-  // each pcb starts at the top of an 8KB block in the kernel
-  pcb_t* new_pcb = (pcb_t*) (EIGHT_MB - (new_pid + 1) * EIGHT_KB);
-  new_pcb->pid = new_pid; // set the pid, indexed at 0
-
-  if (executing_initial_shell || curr_pcb == NULL) {
-    // we are executing an initial shell
-    new_pcb->parent_pcb = NULL;
-    new_pcb->term_index = visible_terminal;
-    executing_initial_shell = 0;
-  } else {
-    new_pcb->parent_pcb = curr_pcb;
-    new_pcb->term_index = curr_pcb->term_index;
-  }
-
-  // save a pointer to the old pcb
-  // pcb_t* old_pcb = curr_pcb; // should never be null
-  // set the current pcb to be the new pcb
-  curr_pcb = new_pcb;
-
-  // update the tail of the pcb list for this terminal
-  terminal_pcbs[curr_pcb->term_index] = curr_pcb;
+  new_pcb->entry_point = entry_point;
+  new_pcb->exec_inode = dir_entry.inode_num;
+  find_shared_text(dir_entry.inode_num, new_pcb);
+  new_pcb->heap_start = new_pcb->brk = find_image_end(dir_entry.inode_num);
+  new_pcb->shm_mapped = 0;
 
-  // copy parsed argument to the buffer in current PCB
-	strcpy((int8_t*) (curr_pcb->arg_buf), arguments);
+  // copy parsed argument to the buffer in the new PCB
+	strcpy((int8_t*) (new_pcb->arg_buf), arguments);
 
   // set the pcb's other data
-  curr_pcb->is_yield = 0;
-  curr_pcb->rtc_freq = 0;
-  curr_pcb->is_yield = 0;
+  new_pcb->rtc_freq = 0;
+  new_pcb->blocked = 0;
+  new_pcb->wait_next = NULL;
+  new_pcb->priority = 0; // start at the top, we don't know it yet
+  new_pcb->slice_ticks = 0;
+  new_pcb->on_run_queue = 0;
+  new_pcb->run_next = NULL;
+  new_pcb->spawned = 0;
+  new_pcb->zombie = 0;
+  new_pcb->exit_status = 0;
+  new_pcb->child_exit.head = NULL;
 
   /* set up the file descriptor tables */
 
-  // first set the stdin/out fops
-  curr_pcb->file_descs[0].fops_table = &stdin_fops;
-  curr_pcb->file_descs[0].inode = dir_entry.inode_num;
-  curr_pcb->file_descs[0].file_position = 0;
-  curr_pcb->file_descs[0].flags = FD_IN_USE;
-  curr_pcb->file_descs[1].fops_table = &stdout_fops;
-  curr_pcb->file_descs[1].inode = dir_entry.inode_num;
-  curr_pcb->file_descs[1].file_position = 0;
-  curr_pcb->file_descs[1].flags = FD_IN_USE;
-
-  // initialize the rest of the fd tables (starting with entry 2)
-  for(i = 2; i < MAX_FDS; i++) {
-    curr_pcb->file_descs[i].fops_table = &null_fops;
-    curr_pcb->file_descs[i].inode = -1;
-    curr_pcb->file_descs[i].file_position = 0;
-    curr_pcb->file_descs[i].flags = FD_NOT_IN_USE;
-  }
-
-  /***** 6. Context Switch *****/
+  // start from an empty table, so fds 0 and 1 are the ones we get
+  init_fd_table(new_pcb);
+  alloc_fd(new_pcb);
+  alloc_fd(new_pcb);
 
-  // update the tss with the kernel stack info
-  tss.ss0 = KERNEL_DS;
-  tss.esp0 = EIGHT_MB - (curr_pcb->pid) * EIGHT_KB - 4;
+  // first set the stdin/out fops
+  new_pcb->file_descs[0].fops_table = &stdin_fops;
+  new_pcb->file_descs[0].inode = dir_entry.inode_num;
+  new_pcb->file_descs[0].file_position = 0;
+  new_pcb->file_descs[0].flags = FD_IN_USE;
+  new_pcb->file_descs[1].fops_table = &stdout_fops;
+  new_pcb->file_descs[1].inode = dir_entry.inode_num;
+  new_pcb->file_descs[1].file_position = 0;
+  new_pcb->file_descs[1].flags = FD_IN_USE;
+
+  return new_pcb;
+}
 
-  // save current ebp and esp
-  asm volatile(
-    "movl %%esp, %0;"
-    "movl %%ebp, %1;"
-    :"=g" (curr_pcb->parent_esp), "=g" (curr_pcb->parent_ebp) // outputs
-    : // inputs
-    : "memory" // clobbered registers
-  );
+/**
+ * spawn_start()
+ *
+ * DESCRIPTION: where a spawned process starts, on top of its own kernel stack,
+ *              the first time the scheduler switches to it. context_switch
+ *              already loaded its page directory and kernel stack.
+ * INPUTS: none
+ * OUTPUTS: none, never returns
+ */
+static void spawn_start() {
+  enter_user(curr_pcb->entry_point);
+}
 
+/**
+ * enter_user()
+ *
+ * DESCRIPTION: drops to ring 3 at the start of the current process's program,
+ *              with its stack at the top of the program page.
+ * INPUTS: entry_point - where the program starts
+ * OUTPUTS: none, never returns
+ */
+static void enter_user(uint32_t entry_point) {
   // switch to ring 3. This code is based on code from wiki.osdev.org
   asm volatile(
     "cli;"
@@ -237,8 +332,100 @@ int32_t system_execute(const uint8_t* command) {
     : "g" (entry_point), "g" (USER_CS), "g" (USER_DS), "g" (NEW_ESP) // input
     : "%eax", "memory" // clobbered registers
   );
+}
 
-  return -1; // we should never actually reach this specific return statment
+/**
+ * find_shared_text()
+ *
+ * DESCRIPTION: works out which pages of an executable can be shared read-only
+ *              between every process running it. These are the pages covered
+ *              by a non-writable loadable segment that no writable segment
+ *              touches (data, bss and the stack stay private).
+ * INPUTS: inode - the inode of the executable
+ *         pcb - the pcb to store the range in (text_start, text_end)
+ * OUTPUTS: none. Leaves an empty range if nothing can be shared.
+ */
+static void find_shared_text(uint32_t inode, pcb_t* pcb) {
+  uint32_t phoff = 0;
+  uint16_t phentsize = 0, phnum = 0;
+  elf_phdr_t phdr;
+  uint32_t start = 0, end = 0;
+  int i;
+
+  pcb->text_start = 0;
+  pcb->text_end = 0;
+
+  read_data(inode, ELF_PHOFF, (uint8_t*)&phoff, sizeof(phoff));
+  read_data(inode, ELF_PHENTSIZE, (uint8_t*)&phentsize, sizeof(phentsize));
+  read_data(inode, ELF_PHNUM, (uint8_t*)&phnum, sizeof(phnum));
+  if (phentsize < sizeof(elf_phdr_t) || phnum > ELF_MAX_PHDRS)
+    return;
+
+  /* the read-only segment has to sit in the file where the flat loader
+   * puts it, otherwise the page contents would not match */
+  for (i = 0; i < phnum; i++) {
+    if (read_data(inode, phoff + i * phentsize, (uint8_t*)&phdr, sizeof(phdr)) != sizeof(phdr))
+      return;
+    if (phdr.type != PT_LOAD || (phdr.flags & PF_W))
+      continue;
+    if (phdr.vaddr < EXEC_ADDR || phdr.offset != phdr.vaddr - EXEC_ADDR)
+      continue;
+    start = PAGE_DOWN(phdr.vaddr);
+    end = PAGE_UP(phdr.vaddr + phdr.filesz);
+    break;
+  }
+
+  /* then cut away any page that a writable segment lands in */
+  for (i = 0; i < phnum && start < end; i++) {
+    read_data(inode, phoff + i * phentsize, (uint8_t*)&phdr, sizeof(phdr));
+    if (phdr.type != PT_LOAD || !(phdr.flags & PF_W))
+      continue;
+    uint32_t w_start = PAGE_DOWN(phdr.vaddr);
+    uint32_t w_end = PAGE_UP(phdr.vaddr + phdr.memsz);
+    if (w_end <= start || w_start >= end)
+      continue;
+    if (w_start <= start)
+      start = w_end;
+    else
+      end = w_start;
+  }
+
+  if (start < end) {
+    pcb->text_start = start;
+    pcb->text_end = end;
+  }
+}
+
+/**
+ * find_image_end()
+ *
+ * DESCRIPTION: finds the first page past everything the executable puts in
+ *              memory (its bss included), which is where its heap starts.
+ * INPUTS: inode - the inode of the executable
+ * OUTPUTS: the page aligned end of the program image
+ */
+static uint32_t find_image_end(uint32_t inode) {
+  uint32_t phoff = 0;
+  uint16_t phentsize = 0, phnum = 0;
+  elf_phdr_t phdr;
+  // the flat loader puts the whole file there in any case
+  uint32_t end = EXEC_ADDR + ((inode_t*)(bootblock + (inode + 1)))->length;
+  int i;
+
+  read_data(inode, ELF_PHOFF, (uint8_t*)&phoff, sizeof(phoff));
+  read_data(inode, ELF_PHENTSIZE, (uint8_t*)&phentsize, sizeof(phentsize));
+  read_data(inode, ELF_PHNUM, (uint8_t*)&phnum, sizeof(phnum));
+  if (phentsize >= sizeof(elf_phdr_t) && phnum <= ELF_MAX_PHDRS) {
+    for (i = 0; i < phnum; i++) {
+      if (read_data(inode, phoff + i * phentsize, (uint8_t*)&phdr, sizeof(phdr)) != sizeof(phdr))
+        break;
+      if (phdr.type == PT_LOAD && phdr.vaddr + phdr.memsz > end && phdr.vaddr + phdr.memsz <= HEAP_LIMIT)
+        end = phdr.vaddr + phdr.memsz;
+    }
+  }
+
+  end = PAGE_UP(end);
+  return end < HEAP_LIMIT ? end : HEAP_LIMIT;
 }
 
 /**
@@ -247,21 +434,61 @@ int32_t system_execute(const uint8_t* command) {
  * DESCRIPTION: corresponds to system call 1. Halts the program and returns
  *              control the parent.
  * INPUTS: status - the return status for the program
- * OUTPUTS: nothing, should jump to execute return.
+ * OUTPUTS: nothing, should jump to execute return (or, for a spawned
+ *          process, to whatever runs next).
  */
 int32_t system_halt(uint8_t status) {
+  return halt_process(status);
+}
+
+/**
+ * halt_process
+ *
+ * DESCRIPTION: does the work of halt. The kernel calls it directly to kill a
+ *              process with a status no program can pass, such as 256 for
+ *              one that caused an exception.
+ * INPUTS: status - the return status for the program
+ * OUTPUTS: nothing, should jump to execute return (or, for a spawned
+ *          process, to whatever runs next).
+ */
+int32_t halt_process(uint32_t status) {
   /* close relevant fds */
   int i;
-  for (i = 0; i < MAX_FDS; i++) {
-    // close the halted pcb's fds
-    system_close(i);
-    (curr_pcb->file_descs[i]).fops_table = &null_fops;
+  for (i = 0; i < curr_pcb->num_fds; i++) {
+    // close the halted pcb's fds, stdin and stdout too since they can be
+    // pipe ends whose other side waits for us to let go
+    if (curr_pcb->file_descs[i].flags == FD_IN_USE) {
+      curr_pcb->file_descs[i].fops_table->close(i);
+    }
+  }
+  free_fd_table(curr_pcb);
+
+  /* give back the shared text pages and memory segments we were using */
+  release_program_pages(curr_pcb->pid);
+  shm_unmap_all();
+
+  /* spawned children we did not wait for are on their own now */
+  orphan_children(curr_pcb);
+
+  /* a spawned process has no execute to return to. It stays a zombie until
+   * its parent picks up the status with wait */
+  if (curr_pcb->spawned) {
+    cli();
+    curr_pcb->exit_status = status;
+    curr_pcb->zombie = 1;
+    if (curr_pcb->parent_pcb != NULL) {
+      wake_up(&curr_pcb->parent_pcb->child_exit);
+    }
+    curr_pcb->blocked = 1;
+    scheduler_pass(); // nothing wakes a zombie, so we never come back
   }
 
   /* restore parent data */
   int32_t saved_esp = curr_pcb->parent_esp;
   int32_t saved_ebp = curr_pcb->parent_ebp;
-  process_array[curr_pcb->pid] = 0;
+  // nothing may run between giving our pid back and leaving its stack
+  cli();
+  free_pcb(curr_pcb);
   terminal_pcbs[curr_pcb->term_index] = curr_pcb->parent_pcb;
   curr_pcb = curr_pcb->parent_pcb;
   num_procs--;
@@ -273,12 +500,11 @@ int32_t system_halt(uint8_t status) {
   }
 
   /* restore parent paging */
-  int32_t phys_addr = EIGHT_MB + (curr_pcb->pid * FOUR_MB);
-  add_program_page((void*)phys_addr, 1);
+  switch_page_directory(curr_pcb->pid);
 
   /* jump to execute return */
   // set the tss esp0 to the current pcb's kernel stack
-  tss.esp0 = EIGHT_MB - (curr_pcb->pid) * EIGHT_KB - 4;
+  tss.esp0 = curr_pcb->kstack_top;
 
   // restore the saved stack, and perform execute's return
   asm volatile(
@@ -290,7 +516,7 @@ int32_t system_halt(uint8_t status) {
     "leave;" // execute's return
     "ret;"
     : // output
-    : "g" ((uint32_t)status), "g" (saved_ebp), "g" (saved_esp)
+    : "g" (status), "g" (saved_ebp), "g" (saved_esp)
     : "%eax" // clobbered registers
   );
 
@@ -309,7 +535,7 @@ int32_t system_halt(uint8_t status) {
  */
 int32_t system_read(int32_t fd, void* buf, int32_t nbytes) {
   /* check if the file descriptor is valid */
-  if (fd < 0 || fd >= MAX_FDS) {
+  if (fd < 0 || fd >= curr_pcb->num_fds) {
     // Note that we do not need to check for NULL because some read calls may be
     // okay with NULL pointers. Let the invidiual read call check for NULL.
     return -1;
@@ -336,7 +562,7 @@ int32_t system_read(int32_t fd, void* buf, int32_t nbytes) {
  */
 int32_t system_write(int32_t fd, const void* buf, int32_t nbytes) {
   /* check if the file descriptor is valid */
-  if (fd < 0 || fd >= MAX_FDS) {
+  if (fd < 0 || fd >= curr_pcb->num_fds) {
     return -1;
   }
 
@@ -358,52 +584,69 @@ int32_t system_write(int32_t fd, const void* buf, int32_t nbytes) {
  * OUTPUTS: the file descriptor allocated to this file
  */
 int32_t system_open(const uint8_t* filename) {
+  // the serial port is a device without an entry in the file system
+  int is_serial = filename != NULL &&
+      strncmp((int8_t*)filename, (int8_t*)SERIAL_NAME, sizeof(SERIAL_NAME)) == 0;
+  // and so is the cpu usage file
+  int is_cpustat = filename != NULL &&
+      strncmp((int8_t*)filename, (int8_t*)CPUSTAT_NAME, sizeof(CPUSTAT_NAME)) == 0;
+
   // find the correspondingly named file
   dentry_t dir_entry;
-  if(read_dentry_by_name(filename, &dir_entry) < 0) {
+  if(!is_serial && !is_cpustat && read_dentry_by_name(filename, &dir_entry) < 0) {
     return -1; // fail
   }
 
-  // allocate an unused file descriptor. make sure to start after stdin/out.
-  int i;
-  for (i = 2; i < MAX_FDS; i++) {
-    if (curr_pcb->file_descs[i].flags == FD_NOT_IN_USE) {
-      // open the file descriptor
-      curr_pcb->file_descs[i].flags = FD_IN_USE;
-      break;
-    }
-  }
-
-  // make sure we found an empty file descriptor
-  if (i == MAX_FDS) {
+  // allocate the lowest unused file descriptor (stdin/out are never free)
+  int i = alloc_fd(curr_pcb);
+  if (i < 0) {
     return -1;
   }
 
   // initialize the file descriptor
-  curr_pcb->file_descs[i].inode = dir_entry.inode_num;
   curr_pcb->file_descs[i].file_position = 0;
+  if (is_serial) {
+    if (serial_open(filename) < 0) {
+      release_fd(curr_pcb, i);
+      return -1;
+    }
+    curr_pcb->file_descs[i].inode = 0;
+    curr_pcb->file_descs[i].fops_table = &serial_fops;
+    return i;
+  }
+  if (is_cpustat) {
+    curr_pcb->file_descs[i].inode = 0;
+    curr_pcb->file_descs[i].fops_table = &cpustat_fops;
+    return i;
+  }
+  curr_pcb->file_descs[i].inode = dir_entry.inode_num;
 
   // set up the proper jump table and open the file
   switch(dir_entry.file_type) {
     case FT_RTC: // rtc
       if (rtc_open(filename) < 0) {
+        release_fd(curr_pcb, i);
         return -1;
       }
       curr_pcb->file_descs[i].fops_table = &rtc_fops;
       break;
     case FT_DIR: // directory
       if (dir_open(filename) < 0) {
+        release_fd(curr_pcb, i);
         return -1;
       }
       curr_pcb->file_descs[i].fops_table = &dir_fops;
       break;
     case FT_REG: // file
       if (file_open(filename) < 0) {
+        release_fd(curr_pcb, i);
         return -1;
       }
       curr_pcb->file_descs[i].fops_table = &file_fops;
       break;
-    default: return -1;
+    default:
+      release_fd(curr_pcb, i);
+      return -1;
   }
   return i; // return the file descriptor
 }
@@ -420,7 +663,7 @@ int32_t system_close(int32_t fd) {
 
   /* check if valid file descriptor. note that the user should never be allowed
   to close the defaults descriptors (0 and 1). */
-  if (fd < 2 || fd >= MAX_FDS) {
+  if (fd < 2 || fd >= curr_pcb->num_fds) {
     return -1;
   }
 
@@ -435,7 +678,8 @@ int32_t system_close(int32_t fd) {
   }
 
   // close the fd by setting it to not in use
-  curr_pcb->file_descs[fd].flags = FD_NOT_IN_USE;
+  release_fd(curr_pcb, fd);
+  curr_pcb->file_descs[fd].fops_table = &null_fops;
 
   return 0;
 }
@@ -491,6 +735,34 @@ int32_t system_vidmap(uint8_t** screen_start) {
   return 0;
 }
 
+/**
+ * init_sysenter
+ *
+ * DESCRIPTION: sets up the SYSENTER MSRs. SYSENTER loads a fixed stack
+ *              pointer, but every process has its own kernel stack, so
+ *              sysenter_entry switches to tss.esp0 right away and the MSR
+ *              only has to hold some valid stack.
+ * INPUTS: none
+ * OUTPUTS: none
+ */
+void init_sysenter() {
+  uint32_t eax, ebx, ecx, edx;
+
+  asm volatile ("cpuid"
+                : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+                : "a" (CPUID_FEATURES));
+  if (!(edx & CPUID_EDX_SEP)) {
+    return;
+  }
+
+  // SYSEXIT derives the user segments from this one (+16 and +24), which
+  // is where USER_CS and USER_DS sit in our gdt
+  asm volatile ("wrmsr" : : "c" (MSR_SYSENTER_CS), "a" (KERNEL_CS), "d" (0));
+  asm volatile ("wrmsr" : : "c" (MSR_SYSENTER_ESP), "a" (tss.esp0), "d" (0));
+  asm volatile ("wrmsr" : : "c" (MSR_SYSENTER_EIP), "a" (&sysenter_entry),
+                "d" (0));
+}
+
 int32_t system_sethandler(int32_t signum, void* handler_address) {
   return -1;
 }
@@ -498,3 +770,341 @@ int32_t system_sethandler(int32_t signum, void* handler_address) {
 int32_t system_sigreturn() {
   return -1;
 }
+
+/**
+ * system_ring_setup
+ *
+ * DESCRIPTION: empties the process's submission/completion ring and hands
+ *              out its address. The ring page needs no mapping of its own,
+ *              it is faulted in zeroed on first use and freed at halt like
+ *              any other page of the program region.
+ * INPUTS: ring - where to store the address of the ring
+ * OUTPUTS: 0 if successful, -1 otherwise
+ */
+int32_t system_ring_setup(io_ring_t** ring) {
+  if ((uint32_t)ring < MB_128 || (uint32_t)ring > MB_132 - sizeof(*ring)) {
+    return -1;
+  }
+
+  io_ring_t* r = (io_ring_t*)RING_ADDR;
+  r->sq_head = r->sq_tail = 0;
+  r->cq_head = r->cq_tail = 0;
+
+  *ring = r;
+  return 0;
+}
+
+/**
+ * system_ring_enter
+ *
+ * DESCRIPTION: runs queued operations from the ring in order, through the
+ *              same calls (and so the same fops tables) as the single system
+ *              calls, and posts a completion for each. Operations run right
+ *              away, so a read that waits for input holds up the ones after it.
+ *              Stops early when the completion queue is full.
+ * INPUTS: to_submit - the most operations to run
+ * OUTPUTS: the number of operations run
+ */
+int32_t system_ring_enter(int32_t to_submit) {
+  io_ring_t* r = (io_ring_t*)RING_ADDR;
+  int32_t done = 0;
+
+  while (done < to_submit && r->sq_head != r->sq_tail &&
+         r->cq_tail - r->cq_head < RING_ENTRIES) {
+    // copy the entry so the process cannot change it under us
+    ring_sqe_t sqe = r->sq[r->sq_head % RING_ENTRIES];
+    int32_t result;
+
+    switch (sqe.opcode) {
+      case RING_OP_READ:
+        result = system_read(sqe.fd, (void*)sqe.buf, sqe.nbytes);
+        break;
+      case RING_OP_WRITE:
+        result = system_write(sqe.fd, (const void*)sqe.buf, sqe.nbytes);
+        break;
+      case RING_OP_OPEN:
+        result = system_open((const uint8_t*)sqe.buf);
+        break;
+      case RING_OP_CLOSE:
+        result = system_close(sqe.fd);
+        break;
+      default:
+        result = -1;
+        break;
+    }
+    r->sq_head++;
+
+    ring_cqe_t* cqe = &r->cq[r->cq_tail % RING_ENTRIES];
+    cqe->user_data = sqe.user_data;
+    cqe->result = result;
+    r->cq_tail++;
+    done++;
+  }
+
+  return done;
+}
+
+/**
+ * system_sendfile
+ *
+ * DESCRIPTION: copies a file straight from the file system to another file
+ *              descriptor. The file system image is in memory, so each run
+ *              of consecutive data blocks is handed to the write call where
+ *              it sits, without a bounce through a user buffer.
+ * INPUTS: out_fd - the file descriptor to write to
+ *         in_fd - the file to read from, starting at its current position
+ *         count - the most bytes to send
+ * OUTPUTS: the number of bytes sent, -1 on failure
+ */
+int32_t system_sendfile(int32_t out_fd, int32_t in_fd, int32_t count) {
+  if (out_fd < 0 || out_fd >= curr_pcb->num_fds || in_fd < 0 ||
+      in_fd >= curr_pcb->num_fds || count < 0) {
+    return -1;
+  }
+
+  fd_entry_t* in = &curr_pcb->file_descs[in_fd];
+  fd_entry_t* out = &curr_pcb->file_descs[out_fd];
+
+  // only regular files have data blocks to send from
+  if (!in->flags || in->fops_table != &file_fops || !out->flags) {
+    return -1;
+  }
+
+  int32_t sent = 0;
+  while (sent < count) {
+    const uint8_t* data;
+    int32_t len = map_data(in->inode, in->file_position, count - sent, &data);
+    if (len <= 0) {
+      break;
+    }
+
+    int32_t written = out->fops_table->write(out_fd, data, len);
+    if (written <= 0) {
+      return sent > 0 ? sent : -1;
+    }
+
+    in->file_position += written;
+    sent += written;
+    if (written < len) {
+      break; // the other end took less, let the caller try again
+    }
+  }
+
+  return sent;
+}
+
+/**
+ * system_brk
+ *
+ * DESCRIPTION: moves the end of the process's heap. Nothing is mapped when
+ *              the heap grows, the page fault handler hands out a zeroed
+ *              frame the first time a heap page is touched. Pages the heap
+ *              shrinks away from are given back right away.
+ * INPUTS: addr - the new end of the heap, NULL to only ask for it
+ * OUTPUTS: the end of the heap if successful, -1 otherwise
+ */
+int32_t system_brk(void* addr) {
+  uint32_t new_brk = (uint32_t)addr;
+
+  if (addr == NULL) {
+    return curr_pcb->brk;
+  }
+  if (new_brk < curr_pcb->heap_start || new_brk > HEAP_LIMIT) {
+    return -1;
+  }
+
+  if (PAGE_UP(new_brk) < PAGE_UP(curr_pcb->brk)) {
+    release_program_range(curr_pcb->pid, PAGE_UP(new_brk), PAGE_UP(curr_pcb->brk));
+  }
+  curr_pcb->brk = new_brk;
+  return new_brk;
+}
+
+/**
+ * system_pipe
+ *
+ * DESCRIPTION: corresponds to system call 15. Makes a pipe and opens both of
+ *              its ends.
+ * INPUTS: fds - where to store the read end (fds[0]) and the write end (fds[1])
+ * OUTPUTS: 0 if successful, -1 otherwise
+ */
+int32_t system_pipe(int32_t* fds) {
+  if ((uint32_t)fds < MB_128 || (uint32_t)fds > MB_132 - 2 * sizeof(int32_t)) {
+    return -1;
+  }
+
+  pipe_t* pipe = pipe_create();
+  if (pipe == NULL) {
+    return -1;
+  }
+
+  int32_t read_fd = alloc_fd(curr_pcb);
+  if (read_fd < 0) {
+    pipe_release(pipe, PIPE_READ_END);
+    pipe_release(pipe, PIPE_WRITE_END);
+    return -1;
+  }
+  int32_t write_fd = alloc_fd(curr_pcb);
+  if (write_fd < 0) {
+    release_fd(curr_pcb, read_fd);
+    pipe_release(pipe, PIPE_READ_END);
+    pipe_release(pipe, PIPE_WRITE_END);
+    return -1;
+  }
+
+  curr_pcb->file_descs[read_fd].fops_table = &pipe_read_fops;
+  curr_pcb->file_descs[read_fd].inode = PIPE_READ_END;
+  curr_pcb->file_descs[read_fd].file_position = 0;
+  curr_pcb->file_descs[read_fd].data = pipe;
+  curr_pcb->file_descs[write_fd].fops_table = &pipe_write_fops;
+  curr_pcb->file_descs[write_fd].inode = PIPE_WRITE_END;
+  curr_pcb->file_descs[write_fd].file_position = 0;
+  curr_pcb->file_descs[write_fd].data = pipe;
+
+  fds[0] = read_fd;
+  fds[1] = write_fd;
+  return 0;
+}
+
+/**
+ * system_spawn
+ *
+ * DESCRIPTION: corresponds to system call 16. Starts the given command next
+ *              to the caller instead of in its place: the new process is put
+ *              on the run queue and the caller goes on right away, which is
+ *              what lets the stages of a pipeline run at the same time. Its
+ *              stdin and stdout can be pipe ends of the caller.
+ * INPUTS: command - the command and arguments to the command, space separated.
+ *         in_fd - the caller's pipe read end to use as stdin, -1 for the terminal
+ *         out_fd - the caller's pipe write end to use as stdout, -1 for the
+ *                  terminal
+ * OUTPUTS: the pid of the new process (for wait), -1 on failure
+ */
+int32_t system_spawn(const uint8_t* command, int32_t in_fd, int32_t out_fd) {
+  if (command == NULL) {
+    return -1;
+  }
+  if (in_fd != -1 && (in_fd < 0 || in_fd >= curr_pcb->num_fds ||
+      !curr_pcb->file_descs[in_fd].flags ||
+      curr_pcb->file_descs[in_fd].fops_table != &pipe_read_fops)) {
+    return -1;
+  }
+  if (out_fd != -1 && (out_fd < 0 || out_fd >= curr_pcb->num_fds ||
+      !curr_pcb->file_descs[out_fd].flags ||
+      curr_pcb->file_descs[out_fd].fops_table != &pipe_write_fops)) {
+    return -1;
+  }
+
+  reap_orphans();
+
+  pcb_t* new_pcb = load_program(command);
+  if (new_pcb == NULL) {
+    return -1;
+  }
+  new_pcb->parent_pcb = curr_pcb;
+  new_pcb->term_index = curr_pcb->term_index;
+  new_pcb->spawned = 1;
+
+  // the child gets its own count on the pipe ends it is handed
+  if (in_fd != -1) {
+    new_pcb->file_descs[0] = curr_pcb->file_descs[in_fd];
+    pipe_dup(new_pcb->file_descs[0].data, PIPE_READ_END);
+  }
+  if (out_fd != -1) {
+    new_pcb->file_descs[1] = curr_pcb->file_descs[out_fd];
+    pipe_dup(new_pcb->file_descs[1].data, PIPE_WRITE_END);
+  }
+
+  // the scheduler starts it in spawn_start the first time it picks it
+  new_pcb->my_esp = 0;
+  new_pcb->my_ebp = 0;
+  new_pcb->start = spawn_start;
+  run_queue_add(new_pcb);
+
+  return new_pcb->pid;
+}
+
+/**
+ * system_wait
+ *
+ * DESCRIPTION: corresponds to system call 17. Waits for a process the
+ *              caller spawned to halt and frees it.
+ * INPUTS: pid - the pid spawn returned
+ * OUTPUTS: the status the process halted with, -1 if it is not a spawned
+ *          child of the caller
+ */
+int32_t system_wait(int32_t pid) {
+  pcb_t* child = get_pcb(pid);
+  if (child == NULL || child == curr_pcb || !child->spawned ||
+      child->parent_pcb != curr_pcb) {
+    return -1;
+  }
+
+  cli();
+  while (!child->zombie) {
+    sleep_on(&curr_pcb->child_exit);
+  }
+  int32_t status = child->exit_status;
+  free_pcb(child);
+  num_procs--;
+  sti();
+
+  return status;
+}
+
+/**
+ * system_isatty
+ *
+ * DESCRIPTION: corresponds to system call 18. Tells whether a file descriptor
+ *              is the terminal, so a program can tell when its stdin or
+ *              stdout was given a pipe instead.
+ * INPUTS: fd - the file descriptor
+ * OUTPUTS: 1 if it is the terminal, 0 if it is something else, -1 if the fd
+ *          is not open
+ */
+int32_t system_isatty(int32_t fd) {
+  if (fd < 0 || fd >= curr_pcb->num_fds || !curr_pcb->file_descs[fd].flags) {
+    return -1;
+  }
+
+  fops_t* fops = curr_pcb->file_descs[fd].fops_table;
+  return (fops == &stdin_fops || fops == &stdout_fops) ? 1 : 0;
+}
+
+/**
+ * system_shm_map
+ *
+ * DESCRIPTION: corresponds to system call 19. Maps a shared memory segment,
+ *              making it if this is the first process to ask for its key.
+ *              Every process gets the same frames at the same address, in
+ *              the window after the vidmap pages.
+ * INPUTS: key - the name of the segment, anything but 0
+ *         size - the bytes needed, 0 to take an existing segment as it is
+ *         addr - where to store the address of the segment
+ * OUTPUTS: 0 if successful, -1 otherwise
+ */
+int32_t system_shm_map(uint32_t key, uint32_t size, void** addr) {
+  if ((uint32_t)addr < MB_128 || (uint32_t)addr > MB_132 - sizeof(*addr)) {
+    return -1;
+  }
+
+  void* segment = shm_map(key, size);
+  if (segment == NULL) {
+    return -1;
+  }
+
+  *addr = segment;
+  return 0;
+}
+
+/**
+ * system_shm_unmap
+ *
+ * DESCRIPTION: corresponds to system call 20. Unmaps a shared memory segment.
+ *              The segment is freed once no process has it mapped.
+ * INPUTS: key - the name of the segment
+ * OUTPUTS: 0 if successful, -1 otherwise
+ */
+int32_t system_shm_unmap(uint32_t key) {
+  return shm_unmap(key);
+}
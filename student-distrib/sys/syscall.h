@@ -9,6 +9,47 @@
 /* some defines to make our code more readable */
 #define EXEC_ADDR 0x08048000
 
+/* the submission/completion ring lives in the first page of the program
+ * region, below the executable, where it is demand zeroed like the heap */
+#define RING_ADDR 0x08000000
+#define RING_ENTRIES 128
+
+/* operations a ring entry can ask for */
+#define RING_OP_READ 0
+#define RING_OP_WRITE 1
+#define RING_OP_OPEN 2
+#define RING_OP_CLOSE 3
+
+/* one queued operation, the arguments are the ones of the system call */
+typedef struct ring_sqe {
+  int32_t opcode;
+  int32_t fd;
+  uint32_t buf;
+  int32_t nbytes;
+  uint32_t user_data;
+} ring_sqe_t;
+
+/* the result of one operation, tagged with its user_data */
+typedef struct ring_cqe {
+  uint32_t user_data;
+  int32_t result;
+} ring_cqe_t;
+
+/* The process fills sq[sq_tail] and moves sq_tail, the kernel consumes
+ * them at sq_head. Completions go the other way round. The indexes run
+ * freely and are taken modulo RING_ENTRIES. */
+typedef struct io_ring {
+  uint32_t sq_head;
+  uint32_t sq_tail;
+  uint32_t cq_head;
+  uint32_t cq_tail;
+  ring_sqe_t sq[RING_ENTRIES];
+  ring_cqe_t cq[RING_ENTRIES];
+} io_ring_t;
+
+/* the heap may grow up to here, the rest of the program page is the stack's */
+#define HEAP_LIMIT 0x08300000
+
 /* the number of system calls */
 #define NUM_SYSCALLS 6
 
@@ -17,6 +58,15 @@ int executing_initial_shell;
 
 /* functions to help us set up the ability to receive a syscall */
 extern int32_t syscall_linker(); // prototype for assembly linkage
+extern void sysenter_entry();     // the SYSENTER entry point, same table
+
+/**
+ * init_sysenter()
+ *
+ * DESCRIPTION: points the SYSENTER MSRs at sysenter_entry if the cpu
+ *              supports SYSENTER/SYSEXIT. int 0x80 keeps working either way.
+ */
+void init_sysenter();
 
 // This function is unnecessary since asm linkage works
 // int32_t syscall_call(int num, int32_t arg1, int32_t arg2, int32_t arg3);
@@ -40,6 +90,16 @@ int32_t run_shell();
  */
 int32_t system_halt(uint8_t status);
 
+/**
+ * halt_process
+ *
+ * DESCRIPTION: halts the current program with any status, including ones a
+ *              program cannot pass to halt itself.
+ * INPUTS: status - the return status for the program
+ * OUTPUTS: nothing, should jump to execute return.
+ */
+int32_t halt_process(uint32_t status);
+
 /**
  * system_execute
  *
@@ -116,4 +176,102 @@ int32_t system_sethandler(int32_t signum, void* handler_address);
 
 int32_t system_sigreturn(void);
 
+/**
+ * system_ring_setup
+ *
+ * DESCRIPTION: empties the process's submission/completion ring and hands
+ *              out its address
+ * INPUTS: ring - where to store the address of the ring
+ * OUTPUTS: 0 if successful, -1 otherwise
+ */
+int32_t system_ring_setup(io_ring_t** ring);
+
+/**
+ * system_ring_enter
+ *
+ * DESCRIPTION: runs queued operations from the ring and posts their results
+ * INPUTS: to_submit - the most operations to run
+ * OUTPUTS: the number of operations run
+ */
+int32_t system_ring_enter(int32_t to_submit);
+
+/**
+ * system_sendfile
+ *
+ * DESCRIPTION: copies a file straight from the file system to another file
+ *              descriptor, such as a terminal or the serial port
+ * INPUTS: out_fd - the file descriptor to write to
+ *         in_fd - the file to read from, starting at its current position
+ *         count - the most bytes to send
+ * OUTPUTS: the number of bytes sent, -1 on failure
+ */
+int32_t system_sendfile(int32_t out_fd, int32_t in_fd, int32_t count);
+
+/**
+ * system_brk
+ *
+ * DESCRIPTION: moves the end of the process's heap
+ * INPUTS: addr - the new end of the heap, NULL to only ask for it
+ * OUTPUTS: the end of the heap if successful, -1 otherwise
+ */
+int32_t system_brk(void* addr);
+
+/**
+ * system_pipe
+ *
+ * DESCRIPTION: makes a pipe and opens both of its ends
+ * INPUTS: fds - where to store the read end (fds[0]) and the write end (fds[1])
+ * OUTPUTS: 0 if successful, -1 otherwise
+ */
+int32_t system_pipe(int32_t* fds);
+
+/**
+ * system_spawn
+ *
+ * DESCRIPTION: starts a command next to the caller instead of in its place
+ * INPUTS: command - the command and arguments to the command, space separated.
+ *         in_fd - a pipe read end to use as stdin, -1 for the terminal
+ *         out_fd - a pipe write end to use as stdout, -1 for the terminal
+ * OUTPUTS: the pid of the new process, -1 on failure
+ */
+int32_t system_spawn(const uint8_t* command, int32_t in_fd, int32_t out_fd);
+
+/**
+ * system_wait
+ *
+ * DESCRIPTION: waits for a spawned child to halt and frees it
+ * INPUTS: pid - the pid spawn returned
+ * OUTPUTS: the status the child halted with, -1 on failure
+ */
+int32_t system_wait(int32_t pid);
+
+/**
+ * system_isatty
+ *
+ * DESCRIPTION: tells whether a file descriptor is the terminal
+ * INPUTS: fd - the file descriptor
+ * OUTPUTS: 1 if it is, 0 if it is not, -1 if the fd is not open
+ */
+int32_t system_isatty(int32_t fd);
+
+/**
+ * system_shm_map
+ *
+ * DESCRIPTION: maps a shared memory segment, making it if needed
+ * INPUTS: key - the name of the segment, anything but 0
+ *         size - the bytes needed, 0 to take an existing segment as it is
+ *         addr - where to store the address of the segment
+ * OUTPUTS: 0 if successful, -1 otherwise
+ */
+int32_t system_shm_map(uint32_t key, uint32_t size, void** addr);
+
+/**
+ * system_shm_unmap
+ *
+ * DESCRIPTION: unmaps a shared memory segment
+ * INPUTS: key - the name of the segment
+ * OUTPUTS: 0 if successful, -1 otherwise
+ */
+int32_t system_shm_unmap(uint32_t key);
+
 #endif
@@ -52,6 +52,7 @@ void init_terminal() {
 	terminal[0].is_started = 1;
 	terminal[0].is_visible = 1;
 	visible_terminal = 0;
+	show_terminal_page(0);
 }
 
 /**
@@ -65,6 +66,10 @@ void launch_terminal() {
 	terminal[visible_terminal].is_started = 1;
 	enable_irq(IRQ_KEYBOARD);
 
+	// whatever was running keeps its place in line while the new shell starts
+	if (!curr_pcb->blocked)
+		run_queue_add(curr_pcb);
+
 	// instead of doing a context switch to the root process, just go back to the
 	// idea of holding a flag and letting execute know that this is an initial
 	// process AFTER SAVING THE STACK POINTERS HERE
@@ -92,8 +97,8 @@ int switch_terminal(int32_t switch_to) {
 	if (switch_to == visible_terminal)
 		return 0;
 
-	/* Update video page */
-	switch_video_page(switch_to, visible_terminal);
+	/* Flip the display over to the new terminal's page */
+	show_terminal_page(switch_to);
 
 	set_terminal_position(visible_terminal);
   	update_screen(switch_to);
@@ -7,6 +7,14 @@
 #include "keyboard.h"
 #include "rtc.h"
 #include "fsys/fs.h"
+#include "mm/pmm.h"
+#include "mm/slab.h"
+#include "mm/shm.h"
+#include "sys/pcb.h"
+#include "scheduler.h"
+#include "serial.h"
+#include "pit.h"
+#include "pipe.h"
 
 #define PASS 1
 #define FAIL 0
@@ -544,6 +552,535 @@ int file_system_dir_output(){
   return PASS;
 }
 
+/**
+ * int dentry_index_test()
+ *
+ * DESCRIPTION: Checks that looking up every dentry by name through the hash
+ *              index finds the same dentry as reading it by index.
+ */
+int dentry_index_test() {
+  TEST_HEADER;
+  dentry_t by_index, by_name;
+  int i;
+
+  for (i = 0; i < bootblock->num_dentries; i++) {
+    if (read_dentry_by_index(i, &by_index) < 0) {
+      return FAIL;
+    }
+    // names that fill all 32 bytes are not null terminated, so copy them out
+    int8_t name[MAX_DIRNAME_LEN + 1];
+    strncpy(name, (int8_t*)by_index.file_name, MAX_DIRNAME_LEN);
+    name[MAX_DIRNAME_LEN] = '\0';
+    if (read_dentry_by_name((uint8_t*)name, &by_name) < 0 ||
+        by_name.inode_num != by_index.inode_num ||
+        by_name.file_type != by_index.file_type) {
+      printf("lookup of %s failed\n", name);
+      return FAIL;
+    }
+  }
+
+  // a missing file and a name that is too long should both fail
+  if (read_dentry_by_name((uint8_t*)"nosuchfile", &by_name) == 0 ||
+      read_dentry_by_name((uint8_t*)"verylargetextwithverylongname.txt", &by_name) == 0) {
+    return FAIL;
+  }
+
+  return PASS;
+}
+
+/**
+ * int read_data_extent_test()
+ *
+ * DESCRIPTION: Checks that reading a multi-block file in one call (a few large
+ *              extent copies) gives the same bytes as reading it in small
+ *              chunks that straddle block boundaries.
+ */
+int read_data_extent_test() {
+  TEST_HEADER;
+  static uint8_t whole[10 * BLOCK_SIZE];
+  static uint8_t chunked[10 * BLOCK_SIZE];
+  dentry_t dentry;
+  int32_t total, got, i;
+
+  if (read_dentry_by_name((uint8_t*)"fish", &dentry) < 0) {
+    return FAIL;
+  }
+
+  total = read_data(dentry.inode_num, 0, whole, sizeof(whole));
+  if (total <= BLOCK_SIZE) {
+    return FAIL; // we want a file that spans several blocks
+  }
+
+  for (i = 0; i < total; i += got) {
+    got = read_data(dentry.inode_num, i, chunked + i, 1000);
+    if (got <= 0) {
+      return FAIL;
+    }
+  }
+
+  for (i = 0; i < total; i++) {
+    if (whole[i] != chunked[i]) {
+      printf("mismatch at byte %d\n", i);
+      return FAIL;
+    }
+  }
+
+  // reading at the end of the file is an EOF
+  if (read_data(dentry.inode_num, total, chunked, 1) != 0) {
+    return FAIL;
+  }
+
+  return PASS;
+}
+
+/**
+ * int map_data_test()
+ *
+ * DESCRIPTION: Checks that walking a file with map_data (what sendfile does)
+ *              finds the same bytes read_data copies.
+ */
+int map_data_test() {
+  TEST_HEADER;
+  static uint8_t whole[10 * BLOCK_SIZE];
+  const uint8_t* data;
+  dentry_t dentry;
+  int32_t total, got, i, j;
+
+  if (read_dentry_by_name((uint8_t*)"fish", &dentry) < 0) {
+    return FAIL;
+  }
+
+  total = read_data(dentry.inode_num, 0, whole, sizeof(whole));
+  for (i = 0; i < total; i += got) {
+    got = map_data(dentry.inode_num, i, total - i, &data);
+    if (got <= 0) {
+      return FAIL;
+    }
+    for (j = 0; j < got; j++) {
+      if (data[j] != whole[i + j]) {
+        printf("mismatch at byte %d\n", i + j);
+        return FAIL;
+      }
+    }
+  }
+
+  if (map_data(dentry.inode_num, total, 1, &data) != 0) {
+    return FAIL;
+  }
+
+  return PASS;
+}
+
+/**
+ * int frame_alloc_test()
+ *
+ * DESCRIPTION: Takes two frames from the frame allocator and checks that they
+ *              are distinct, page aligned and outside the kernel, and that
+ *              freeing them puts the free count back.
+ */
+int frame_alloc_test() {
+  TEST_HEADER;
+  uint32_t before = pmm_free_count();
+  uint32_t a, b;
+
+  if (before < 2 || before > pmm_total_count()) {
+    return FAIL;
+  }
+
+  a = pmm_alloc_frame();
+  b = pmm_alloc_frame();
+  if (a == PMM_NO_FRAME || b == PMM_NO_FRAME || a == b) {
+    return FAIL;
+  }
+  if (a < PMM_KERNEL_END || b < PMM_KERNEL_END ||
+      (a & (FRAME_SIZE - 1)) || (b & (FRAME_SIZE - 1))) {
+    return FAIL;
+  }
+  if (pmm_free_count() != before - 2) {
+    return FAIL;
+  }
+
+  pmm_free_frame(a);
+  pmm_free_frame(b);
+  pmm_free_frame(b); // freeing twice must not count twice
+  if (pmm_free_count() != before) {
+    return FAIL;
+  }
+
+  return PASS;
+}
+
+/**
+ * int slab_alloc_test()
+ *
+ * DESCRIPTION: Fills more than one slab of a cache, checks the objects are
+ *              distinct and inside the kernel page, then frees them and checks
+ *              the pages come back. Also checks the kmalloc size limits.
+ */
+int slab_alloc_test() {
+  TEST_HEADER;
+  static slab_cache_t* cache = NULL;
+  static uint8_t* objs[200];
+  uint32_t before = slab_free_pages();
+  void* page;
+  int i, j;
+
+  if (cache == NULL && (cache = slab_cache_create("test", 100)) == NULL) {
+    return FAIL;
+  }
+
+  for (i = 0; i < 200; i++) {
+    objs[i] = slab_alloc(cache);
+    if (objs[i] == NULL || (uint32_t)objs[i] < SLAB_HEAP_BASE ||
+        (uint32_t)objs[i] + cache->size > SLAB_HEAP_END) {
+      return FAIL;
+    }
+    memset(objs[i], i, cache->size);
+  }
+
+  // nothing may have been handed out twice
+  for (i = 0; i < 200; i++) {
+    for (j = 0; j < cache->size; j++) {
+      if (objs[i][j] != (uint8_t)i) {
+        return FAIL;
+      }
+    }
+  }
+
+  for (i = 0; i < 200; i++) {
+    slab_free(objs[i]);
+  }
+  // the last empty slab stays with the cache
+  if (cache->in_use != 0 || slab_free_pages() + 1 < before) {
+    return FAIL;
+  }
+
+  page = kmalloc(SLAB_MAX_OBJECT);
+  if (page == NULL || ((uint32_t)page & (SLAB_PAGE_SIZE - 1)) ||
+      kmalloc(SLAB_MAX_OBJECT + 1) != NULL) {
+    return FAIL;
+  }
+  kfree(page);
+
+  return PASS;
+}
+
+/**
+ * int pcb_alloc_test()
+ *
+ * DESCRIPTION: Takes two pcbs and checks that they get different pids, that
+ *              their kernel stacks sit in their own slots right under the pcb,
+ *              and that a freed pid is handed out again.
+ */
+int pcb_alloc_test() {
+  TEST_HEADER;
+  pcb_t* a = alloc_pcb();
+  pcb_t* b = alloc_pcb();
+  pcb_t* c;
+  int pid;
+
+  if (a == NULL || b == NULL || a->pid == b->pid) {
+    return FAIL;
+  }
+  if (get_pcb(a->pid) != a || get_pcb(b->pid) != b) {
+    return FAIL;
+  }
+  if (a->kstack_top != (uint32_t)a - 4 ||
+      a->kstack_top < PROC_SLOT(a->pid) + SLOT_STACK * FOUR_KB) {
+    return FAIL;
+  }
+
+  // the stack has to be writable all the way down to the guard page
+  *(uint32_t*)(PROC_SLOT(b->pid) + SLOT_STACK * FOUR_KB) = 0xECE391;
+
+  pid = a->pid;
+  free_pcb(a);
+  if (get_pcb(pid) != NULL) {
+    return FAIL;
+  }
+  c = alloc_pcb();
+  if (c == NULL || c->pid != pid) {
+    return FAIL;
+  }
+
+  free_pcb(b);
+  free_pcb(c);
+  return PASS;
+}
+
+/**
+ * int fd_table_test()
+ *
+ * DESCRIPTION: Opens more fds than fit in the pcb so the table has to grow,
+ *              checks they come out lowest first, that freed fds are reused
+ *              lowest first, and that the grown table goes back to the heap.
+ */
+int fd_table_test() {
+  TEST_HEADER;
+  static pcb_t pcb;
+  uint32_t pages = slab_free_pages();
+  int32_t i;
+
+  init_fd_table(&pcb);
+  for (i = 0; i < 200; i++) {
+    if (alloc_fd(&pcb) != i) {
+      return FAIL;
+    }
+  }
+  if (pcb.num_fds < 200 || pcb.file_descs == pcb.fd_inline) {
+    return FAIL;
+  }
+
+  release_fd(&pcb, 100);
+  release_fd(&pcb, 5);
+  if (alloc_fd(&pcb) != 5 || alloc_fd(&pcb) != 100 || alloc_fd(&pcb) != 200) {
+    return FAIL;
+  }
+
+  // the table grows past 128 all the way to FD_TABLE_MAX, then stops
+  for (i = 201; i < FD_TABLE_MAX; i++) {
+    if (alloc_fd(&pcb) != i) {
+      return FAIL;
+    }
+  }
+  if (pcb.num_fds != FD_TABLE_MAX || alloc_fd(&pcb) != -1) {
+    return FAIL;
+  }
+
+  free_fd_table(&pcb);
+  if (pcb.num_fds != MAX_FDS || pcb.file_descs != pcb.fd_inline ||
+      slab_free_pages() + 1 < pages) {
+    return FAIL;
+  }
+
+  return PASS;
+}
+
+/**
+ * int pipe_test()
+ *
+ * DESCRIPTION: Pushes data through a pipe so it wraps around the end of the
+ *              buffer and checks it comes out in order, then that the reader
+ *              sees the end of the data once the writer is gone and that the
+ *              pipe goes back to the heap.
+ */
+int pipe_test() {
+  TEST_HEADER;
+  static uint8_t in[PIPE_BUF_SIZE], out[2 * PIPE_BUF_SIZE];
+  uint32_t pages = slab_free_pages();
+  int32_t rfd, wfd, i;
+
+  pipe_t* pipe = pipe_create();
+  if (pipe == NULL) {
+    return FAIL;
+  }
+  rfd = alloc_fd(curr_pcb);
+  wfd = alloc_fd(curr_pcb);
+  curr_pcb->file_descs[rfd].inode = PIPE_READ_END;
+  curr_pcb->file_descs[rfd].data = pipe;
+  curr_pcb->file_descs[wfd].inode = PIPE_WRITE_END;
+  curr_pcb->file_descs[wfd].data = pipe;
+
+  for (i = 0; i < PIPE_BUF_SIZE; i++) {
+    in[i] = (uint8_t)(i * 7);
+  }
+
+  // fill three quarters, take one back out, then fill it up across the end
+  if (pipe_write(wfd, in, 3072) != 3072 || pipe_read(rfd, out, 1024) != 1024 ||
+      pipe_write(wfd, in, 2048) != 2048) {
+    return FAIL;
+  }
+  if (pipe_read(rfd, out + 1024, PIPE_BUF_SIZE) != PIPE_BUF_SIZE) {
+    return FAIL;
+  }
+  for (i = 0; i < 1024 + PIPE_BUF_SIZE; i++) {
+    if (out[i] != ((i < 3072) ? in[i] : in[i - 3072])) {
+      return FAIL;
+    }
+  }
+
+  // no writers and nothing buffered is the end of the data
+  pipe_close(wfd);
+  release_fd(curr_pcb, wfd);
+  if (pipe_read(rfd, out, PIPE_BUF_SIZE) != 0) {
+    return FAIL;
+  }
+  pipe_close(rfd);
+  release_fd(curr_pcb, rfd);
+
+  if (slab_free_pages() + 2 < pages) {
+    return FAIL;
+  }
+
+  return PASS;
+}
+
+/**
+ * int shm_test()
+ *
+ * DESCRIPTION: Maps one segment into two address spaces and checks that what
+ *              one writes the other reads at the same address, that a new
+ *              segment comes zeroed, and that its frames go back once both
+ *              have unmapped it. Interrupts stay off so the scheduler never
+ *              sees the borrowed pcbs.
+ */
+int shm_test() {
+  TEST_HEADER;
+  uint32_t flags;
+  pcb_t* a = alloc_pcb();
+  pcb_t* b = alloc_pcb();
+  uint32_t before = pmm_free_count(); // after the pcb slots are backed
+  uint32_t* p;
+  uint32_t* q;
+  int result = PASS;
+  int i;
+
+  if (a == NULL || b == NULL) {
+    return FAIL;
+  }
+  setup_program_page(a->pid);
+  setup_program_page(b->pid);
+  a->shm_mapped = b->shm_mapped = 0;
+
+  cli_and_save(flags);
+  curr_pcb = a;
+  switch_page_directory(a->pid);
+  p = shm_map(0x391, 2 * FOUR_KB);
+  if (p == NULL || shm_map(0x392, SHM_SEGMENT_SIZE + 1) != NULL) {
+    result = FAIL;
+  } else {
+    for (i = 0; i < 2 * FOUR_KB / 4; i++) {
+      if (p[i] != 0) {
+        result = FAIL;
+      }
+      p[i] = i;
+    }
+  }
+
+  curr_pcb = b;
+  switch_page_directory(b->pid);
+  q = shm_map(0x391, 0);
+  if (result == PASS && (q != p || q[1234] != 1234 || shm_map(0x391, 3 * FOUR_KB) != NULL)) {
+    result = FAIL;
+  }
+  if (q != NULL) {
+    q[5] = 0xECE391;
+  }
+  shm_unmap_all();
+
+  curr_pcb = a;
+  switch_page_directory(a->pid);
+  if (result == PASS && p[5] != 0xECE391) {
+    result = FAIL;
+  }
+  if (shm_unmap(0x391) != 0 || shm_unmap(0x391) != -1) {
+    result = FAIL;
+  }
+
+  curr_pcb = &root_pcb;
+  switch_page_directory(-1);
+  restore_flags(flags);
+
+  free_pcb(a);
+  free_pcb(b);
+  if (pmm_free_count() != before) {
+    return FAIL;
+  }
+  return result;
+}
+
+/**
+ * int run_queue_test()
+ *
+ * DESCRIPTION: Puts processes of different priority levels on the run queues
+ *              and checks that they come back off highest level first, and
+ *              in order within a level.
+ */
+int run_queue_test() {
+  TEST_HEADER;
+  static pcb_t procs[4];
+  int levels[4] = {2, 0, 1, 0};
+  int expected[4] = {1, 3, 2, 0};
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    procs[i].pid = i;
+    procs[i].priority = levels[i];
+    procs[i].on_run_queue = 0;
+    run_queue_add(&procs[i]);
+  }
+  run_queue_add(&procs[0]); // adding twice must not queue it twice
+
+  for (i = 0; i < 4; i++) {
+    if (find_next_pid() != expected[i]) {
+      return FAIL;
+    }
+  }
+  if (find_next_pid() != -1) {
+    return FAIL;
+  }
+
+  return PASS;
+}
+
+/* Serial Test
+ *
+ * DESCRIPTION: Queues a line on COM1 and checks that the transmit interrupt
+ *              drains it within a few pit ticks. Run qemu with
+ *              -serial file:<path> to see the line.
+ */
+int serial_test() {
+  TEST_HEADER;
+  uint8_t line[] = "serial test\n";
+  int start;
+
+  // nothing to check without a uart
+  if (serial_open((uint8_t*)SERIAL_NAME) < 0) {
+    return PASS;
+  }
+
+  serial_log(line, sizeof(line) - 1);
+  start = pit_ticks;
+  while (serial_tx_pending() > 0 && pit_ticks - start < 20) {
+    asm volatile ("hlt");
+  }
+
+  return serial_tx_pending() == 0 ? PASS : FAIL;
+}
+
+/**
+ * int cpustat_test()
+ *
+ * DESCRIPTION: Reads the cpu usage file a few bytes at a time and checks it
+ *              comes out as one whole line, and that the idle ticks never
+ *              exceed the total.
+ */
+int cpustat_test() {
+  TEST_HEADER;
+  uint8_t line[64];
+  uint32_t idle, total;
+  int32_t fd, n, len = 0;
+
+  get_cpu_ticks(&idle, &total);
+  if (idle > total) {
+    return FAIL;
+  }
+
+  fd = alloc_fd(curr_pcb);
+  curr_pcb->file_descs[fd].file_position = 0;
+  while (len < sizeof(line) - 1 && (n = cpustat_read(fd, line + len, 5)) > 0) {
+    len += n;
+  }
+  release_fd(curr_pcb, fd);
+  line[len] = '\0';
+
+  if (strncmp((int8_t*)line, "idle ", 5) != 0 || len < 7 ||
+      strncmp((int8_t*)line + len - 7, "% busy\n", 7) != 0) {
+    return FAIL;
+  }
+  return PASS;
+}
+
 /* Checkpoint 3 tests */
 /* Checkpoint 4 tests */
 /* Checkpoint 5 tests */
@@ -559,6 +1096,18 @@ void launch_tests() {
   TEST_OUTPUT("idt_test2", idt_test2());
   TEST_OUTPUT("page test", page_value_test());
   TEST_OUTPUT("page deref test", page_deref_test());
+  TEST_OUTPUT("dentry index test", dentry_index_test());
+  TEST_OUTPUT("read data extent test", read_data_extent_test());
+  TEST_OUTPUT("map data test", map_data_test());
+  TEST_OUTPUT("frame alloc test", frame_alloc_test());
+  TEST_OUTPUT("slab alloc test", slab_alloc_test());
+  TEST_OUTPUT("pcb alloc test", pcb_alloc_test());
+  TEST_OUTPUT("fd table test", fd_table_test());
+  TEST_OUTPUT("pipe test", pipe_test());
+  TEST_OUTPUT("shm test", shm_test());
+  TEST_OUTPUT("run queue test", run_queue_test());
+  TEST_OUTPUT("serial test", serial_test());
+  TEST_OUTPUT("cpustat test", cpustat_test());
 
   // TEST_OUTPUT("rtc write test", rtc_read_test());
   // printf("Finished RTC Read Test \n");
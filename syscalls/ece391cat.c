@@ -3,30 +3,62 @@
 #include "ece391support.h"
 #include "ece391syscall.h"
 
+#define CHUNK 1024
+#define SEND_CHUNK 16384
+
+/* one chunk is written out while the next one is read in */
+static uint8_t bufs[2][CHUNK];
+
 int main ()
 {
-    int32_t fd, cnt;
-    uint8_t buf[1024];
+    int32_t fd, cnt, cur;
+    io_ring_t* ring;
+    ring_cqe_t cqe;
 
-    if (0 != ece391_getargs (buf, 1024)) {
-        ece391_fdputs (1, (uint8_t*)"could not read arguments\n");
+    if (0 != ece391_getargs (bufs[0], CHUNK)) {
+        ece391_bufputs (1, (uint8_t*)"could not read arguments\n");
 	return 3;
     }
 
-    if (-1 == (fd = ece391_open (buf))) {
-        ece391_fdputs (1, (uint8_t*)"file not found\n");
+    if (-1 == (fd = ece391_open (bufs[0]))) {
+        ece391_bufputs (1, (uint8_t*)"file not found\n");
 	return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, 1024))) {
+    /* regular files go straight from the file system to the terminal */
+    while (0 < (cnt = ece391_sendfile (1, fd, SEND_CHUNK)))
+        ;
+    if (0 == cnt)
+        return 0;
+
+    /* anything else (or a file sendfile stopped at a NUL in) is copied */
+    if (-1 == ece391_ring_setup (&ring)) {
+        ece391_bufputs (1, (uint8_t*)"could not set up ring\n");
+	return 3;
+    }
+
+    cnt = ece391_read (fd, bufs[0], CHUNK);
+    cur = 0;
+    while (0 != cnt) {
         if (-1 == cnt) {
-	    ece391_fdputs (1, (uint8_t*)"file read failed\n");
+	    ece391_bufputs (1, (uint8_t*)"file read failed\n");
 	    return 3;
 	}
-	if (-1 == ece391_write (1, buf, cnt))
-	    return 3;
+
+	/* write this chunk and read the next in a single trip to the kernel */
+	ece391_ring_queue (ring, RING_OP_WRITE, 1, bufs[cur], cnt, RING_OP_WRITE);
+	ece391_ring_queue (ring, RING_OP_READ, fd, bufs[1 - cur], CHUNK, RING_OP_READ);
+	ece391_ring_enter (2);
+	while (0 == ece391_ring_reap (ring, &cqe)) {
+	    if (RING_OP_WRITE == cqe.user_data) {
+		if (-1 == cqe.result)
+		    return 3;
+	    } else {
+		cnt = cqe.result;
+	    }
+	}
+	cur = 1 - cur;
     }
 
     return 0;
 }
-
@@ -10,15 +10,16 @@ int main ()
     uint32_t i, cnt, max = 0;
     uint8_t buf[BUFSIZE];
 
-    ece391_fdputs(1, (uint8_t*)"Enter the Test Number: (0): 100, (1): 10000, (2): 100000\n");
+    ece391_bufputs(1, (uint8_t*)"Enter the Test Number: (0): 100, (1): 10000, (2): 100000\n");
+    ece391_flush(1);
     if (-1 == (cnt = ece391_read(0, buf, BUFSIZE-1)) ) {
-        ece391_fdputs(1, (uint8_t*)"Can't read the number from keyboard.\n");
+        ece391_bufputs(1, (uint8_t*)"Can't read the number from keyboard.\n");
      return 3;
     }
     buf[cnt] = '\0';
 
     if ((ece391_strlen(buf) > 2) || ((ece391_strlen(buf) == 2) && ((buf[0] < '0') || (buf[0] > '2')))) {
-        ece391_fdputs(1, (uint8_t*)"Wrong Choice!\n");
+        ece391_bufputs(1, (uint8_t*)"Wrong Choice!\n");
         return 0;
     } else {
         switch (buf[0]) {
@@ -36,8 +37,8 @@ int main ()
 
     for (i = 0; i < max; i++) {
         ece391_itoa(i+1, buf, 10);
-        ece391_fdputs(1, buf);
-        ece391_fdputs(1, (uint8_t*)"\n");
+        ece391_bufputs(1, buf);
+        ece391_bufputs(1, (uint8_t*)"\n");
     }
 
     return 0;
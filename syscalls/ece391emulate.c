@@ -176,6 +176,16 @@ ece391_vidmap (uint8_t** screen_start)
     return 0;
 }
 
+int32_t 
+ece391_brk (void* addr)
+{
+    if (NULL == addr)
+        return (int32_t)sbrk (0);
+    if (-1 == brk (addr))
+        return -1;
+    return (int32_t)addr;
+}
+
 int32_t 
 ece391_read (int32_t fd, void* buf, int32_t nbytes)
 {
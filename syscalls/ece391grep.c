@@ -6,22 +6,19 @@
 #define BUFSIZE 1024
 #define SBUFSIZE 33
 
+/* fname is printed in front of matching lines, 0 for none */
 int32_t
-do_one_file (const char* s, const char* fname) 
+search_fd (const char* s, int32_t fd, const char* fname)
 {
-    int32_t fd, cnt, last, line_start, line_end, check, s_len;
+    int32_t cnt, last, line_start, line_end, check, s_len;
     uint8_t data[BUFSIZE+1];
 
     s_len = ece391_strlen ((uint8_t*)s);
-    if (-1 == (fd = ece391_open ((uint8_t*)fname))) {
-        ece391_fdputs (1, (uint8_t*)"file open failed\n");
-        return -1;
-    }
     last = 0;
     while (1) {
         cnt = ece391_read (fd, data + last, BUFSIZE - last);
 	if (-1 == cnt) {
-            ece391_fdputs (1, (uint8_t*)"file read failed\n");
+            ece391_bufputs (1, (uint8_t*)"file read failed\n");
             return -1;
 	}
 	last += cnt;
@@ -30,7 +27,10 @@ do_one_file (const char* s, const char* fname)
 	    line_end = line_start;
 	    while (line_end < last && '\n' != data[line_end])
 		line_end++;
-	    if ('\n' != data[line_end] && 0 != cnt && line_start != 0) {
+	    /* a pipe hands over whatever is there, so keep reading until
+	       the line is complete or the buffer is full */
+	    if (line_end == last && 0 != cnt &&
+		(line_start != 0 || last < BUFSIZE)) {
 		/* copy from line_start to last down to 0 and fix last */
 		data[line_end] = '\0';
 		ece391_strcpy (data, data + line_start);
@@ -42,10 +42,12 @@ do_one_file (const char* s, const char* fname)
 	    for (check = line_start; check < line_end; check++) {
 		if (s[0] == data[check] && 
 		    0 == ece391_strncmp ((uint8_t*)(data + check), (uint8_t*)s, s_len)) {
-		    ece391_fdputs (1, (uint8_t*)fname);
-		    ece391_fdputs (1, (uint8_t*)":");
-		    ece391_fdputs (1, data + line_start);
-		    ece391_fdputs (1, (uint8_t*)"\n");
+		    if (0 != fname) {
+			ece391_bufputs (1, (uint8_t*)fname);
+			ece391_bufputs (1, (uint8_t*)":");
+		    }
+		    ece391_bufputs (1, data + line_start);
+		    ece391_bufputs (1, (uint8_t*)"\n");
 		    break;
 		}
 	    }
@@ -58,8 +60,22 @@ do_one_file (const char* s, const char* fname)
 	if (0 == cnt)
 	    break;
     }
+    return 0;
+}
+
+int32_t
+do_one_file (const char* s, const char* fname) 
+{
+    int32_t fd;
+
+    if (-1 == (fd = ece391_open ((uint8_t*)fname))) {
+        ece391_bufputs (1, (uint8_t*)"file open failed\n");
+        return -1;
+    }
+    if (0 != search_fd (s, fd, fname))
+        return -1;
     if (-1 == ece391_close (fd)) {
-        ece391_fdputs (1, (uint8_t*)"file close failed\n");
+        ece391_bufputs (1, (uint8_t*)"file close failed\n");
         return -1;
     }
     return 0;
@@ -72,18 +88,22 @@ int main ()
     uint8_t search[BUFSIZE];
 
     if (0 != ece391_getargs (search, BUFSIZE)) {
-        ece391_fdputs (1, (uint8_t*)"could not read argument\n");
+        ece391_bufputs (1, (uint8_t*)"could not read argument\n");
         return 3;
     }
 
+    /* at the end of a pipeline, search what comes through the pipe */
+    if (0 == ece391_isatty (0))
+        return (0 != search_fd ((char*)search, 0, 0)) ? 3 : 0;
+
     if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
-        ece391_fdputs (1, (uint8_t*)"directory open failed\n");
+        ece391_bufputs (1, (uint8_t*)"directory open failed\n");
 	return 2;
     }
 
     while (0 != (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
         if (-1 == cnt) {
-	    ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
+	    ece391_bufputs (1, (uint8_t*)"directory entry read failed\n");
 	    return 3;
 	}
 	if ('.' == buf[0]) /* a directory... */
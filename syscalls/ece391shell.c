@@ -4,17 +4,79 @@
 #include "ece391syscall.h"
 
 #define BUFSIZE 1024
+#define MAX_STAGES 8
+
+/*
+ * Runs a command line. A line with '|' in it is a pipeline: every stage
+ * is spawned with its stdout on a pipe to the next stage's stdin, so they
+ * all run at once, and the line's status is the one of the last stage.
+ */
+static int32_t
+run_line (uint8_t* line)
+{
+    uint8_t* stage[MAX_STAGES];
+    int32_t pid[MAX_STAGES];
+    int32_t fds[2];
+    int32_t n_stages, n_spawned, i, start, end, in_fd, rval;
+
+    n_stages = 1;
+    stage[0] = line;
+    for (i = 0; '\0' != line[i]; i++) {
+        if ('|' != line[i])
+	    continue;
+	if (MAX_STAGES == n_stages)
+	    return -1;
+	/* drop the spaces in front of the '|' */
+	for (end = i; end > 0 && ' ' == line[end - 1]; end--);
+	line[end] = '\0';
+	/* and the ones after it */
+	for (start = i + 1; ' ' == line[start]; start++);
+	stage[n_stages++] = line + start;
+	line[i] = '\0';
+    }
+    if (1 == n_stages)
+        return ece391_execute (line);
+
+    in_fd = -1;
+    for (n_spawned = 0; n_spawned < n_stages; n_spawned++) {
+	fds[0] = fds[1] = -1;
+	if (n_spawned < n_stages - 1 && -1 == ece391_pipe (fds))
+	    break;
+	pid[n_spawned] = ece391_spawn (stage[n_spawned], in_fd, fds[1]);
+	/* the stages hold their own ends, ours would keep the pipes open */
+	if (-1 != in_fd)
+	    ece391_close (in_fd);
+	if (-1 != fds[1])
+	    ece391_close (fds[1]);
+	in_fd = fds[0];
+	if (-1 == pid[n_spawned])
+	    break;
+    }
+    /* a stage that failed to start leaves us the read end nobody took */
+    if (-1 != in_fd)
+        ece391_close (in_fd);
+
+    rval = (n_spawned < n_stages) ? -1 : 0;
+    for (i = 0; i < n_spawned; i++) {
+	if (-1 != rval)
+	    rval = ece391_wait (pid[i]);
+	else
+	    ece391_wait (pid[i]);
+    }
+    return rval;
+}
 
 int main ()
 {
     int32_t cnt, rval;
     uint8_t buf[BUFSIZE];
-    ece391_fdputs (1, (uint8_t*)"Starting 391 Shell\n");
+    ece391_bufputs (1, (uint8_t*)"Starting 391 Shell\n");
 
     while (1) {
-        ece391_fdputs (1, (uint8_t*)"391OS> ");
+        ece391_bufputs (1, (uint8_t*)"391OS> ");
+        ece391_flush (1);
 	if (-1 == (cnt = ece391_read (0, buf, BUFSIZE-1))) {
-	    ece391_fdputs (1, (uint8_t*)"read from keyboard failed\n");
+	    ece391_bufputs (1, (uint8_t*)"read from keyboard failed\n");
 	    return 3;
 	}
 	if (cnt > 0 && '\n' == buf[cnt - 1])
@@ -24,13 +86,13 @@ int main ()
 	    return 0;
 	if ('\0' == buf[0])
 	    continue;
-	rval = ece391_execute (buf);
+	rval = run_line (buf);
 	if (-1 == rval)
-	    ece391_fdputs (1, (uint8_t*)"no such command\n");
+	    ece391_bufputs (1, (uint8_t*)"no such command\n");
 	else if (256 == rval)
-	    ece391_fdputs (1, (uint8_t*)"program terminated by exception\n");
+	    ece391_bufputs (1, (uint8_t*)"program terminated by exception\n");
 	else if (0 != rval)
-	    ece391_fdputs (1, (uint8_t*)"program terminated abnormally\n");
+	    ece391_bufputs (1, (uint8_t*)"program terminated abnormally\n");
     }
 }
 
@@ -0,0 +1,157 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * The fish animation split over two processes. "shmfish" renders: it maps
+ * a shared memory segment, spawns "shmfish gen" to draw the frames into it
+ * and copies every finished frame to video memory. The generator never
+ * touches the screen and the frames are never copied between the two.
+ */
+
+#define SHM_KEY 0x391F
+#define NUM_SLOTS 4
+#define ROWS 25
+#define COLS 80
+#define FISH_ROW 6
+#define FRAME_SIZE 512
+#define NUM_STEPS (2 * COLS)
+#define STEPS_PER_FRAME 4
+#define RTC_FREQ 16
+#define BUFSIZE 128
+
+/* a ring of whole screens, the generator fills them and the renderer
+   shows them in order */
+typedef struct {
+    volatile int32_t produced;
+    volatile int32_t consumed;
+    volatile int32_t done;
+    uint8_t screen[NUM_SLOTS][ROWS * COLS];
+} anim_t;
+
+static uint8_t fish[2][FRAME_SIZE];
+static int32_t fish_len[2];
+
+static int32_t
+load_frame (const uint8_t* fname, uint8_t* buf)
+{
+    int32_t fd, cnt;
+
+    if (-1 == (fd = ece391_open (fname)))
+        return -1;
+    cnt = ece391_read (fd, buf, FRAME_SIZE);
+    ece391_close (fd);
+    return cnt;
+}
+
+/* draws a fish frame into a screen with its left edge at column x */
+static void
+draw_frame (uint8_t* screen, const uint8_t* frame, int32_t len, int32_t x)
+{
+    int32_t i, row, col;
+
+    for (i = 0; i < ROWS * COLS; i++)
+        screen[i] = ' ';
+    row = FISH_ROW;
+    col = 0;
+    for (i = 0; i < len && row < ROWS; i++) {
+        if ('\n' == frame[i]) {
+	    row++;
+	    col = 0;
+	    continue;
+	}
+	screen[row * COLS + (x + col) % COLS] = frame[i];
+	col++;
+    }
+}
+
+static int32_t
+generate (anim_t* anim)
+{
+    int32_t rtc_fd, step, garbage, freq = RTC_FREQ;
+
+    if (-1 == (fish_len[0] = load_frame ((uint8_t*)"frame0.txt", fish[0])) ||
+        -1 == (fish_len[1] = load_frame ((uint8_t*)"frame1.txt", fish[1]))) {
+        anim->done = 1;
+        return 2;
+    }
+    rtc_fd = ece391_open ((uint8_t*)"rtc");
+    ece391_write (rtc_fd, &freq, 4);
+
+    for (step = 0; step < NUM_STEPS; step++) {
+        /* wait for the renderer to free a slot */
+        while (NUM_SLOTS == anim->produced - anim->consumed)
+	    ece391_read (rtc_fd, &garbage, 4);
+	draw_frame (anim->screen[anim->produced % NUM_SLOTS],
+		    fish[(step / STEPS_PER_FRAME) & 1],
+		    fish_len[(step / STEPS_PER_FRAME) & 1], step % COLS);
+	anim->produced++;
+    }
+    anim->done = 1;
+
+    ece391_close (rtc_fd);
+    return 0;
+}
+
+static int32_t
+render (anim_t* anim)
+{
+    int32_t rtc_fd, pid, i, garbage, freq = RTC_FREQ;
+    uint8_t* vmem;
+    uint8_t* screen;
+
+    if (-1 == ece391_vidmap (&vmem)) {
+        ece391_bufputs (1, (uint8_t*)"could not map video memory\n");
+        return 3;
+    }
+    rtc_fd = ece391_open ((uint8_t*)"rtc");
+    ece391_write (rtc_fd, &freq, 4);
+
+    if (-1 == (pid = ece391_spawn ((uint8_t*)"shmfish gen", -1, -1))) {
+        ece391_bufputs (1, (uint8_t*)"could not start the generator\n");
+        return 3;
+    }
+
+    while (!anim->done || anim->consumed != anim->produced) {
+        ece391_read (rtc_fd, &garbage, 4);
+	if (anim->consumed == anim->produced)
+	    continue;
+	/* video memory holds a character and an attribute byte per cell */
+	screen = anim->screen[anim->consumed % NUM_SLOTS];
+	for (i = 0; i < ROWS * COLS; i++)
+	    vmem[2 * i] = screen[i];
+	anim->consumed++;
+    }
+
+    ece391_close (rtc_fd);
+    return (0 == ece391_wait (pid)) ? 0 : 2;
+}
+
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    anim_t* anim;
+    int32_t rval;
+
+    if (0 != ece391_getargs (buf, BUFSIZE)) {
+        ece391_bufputs (1, (uint8_t*)"could not read arguments\n");
+	return 3;
+    }
+
+    /* the renderer makes the segment, the generator takes it as it is */
+    if (0 == ece391_strcmp (buf, (uint8_t*)"gen")) {
+        if (-1 == ece391_shm_map (SHM_KEY, 0, (void**)&anim))
+	    return 3;
+	rval = generate (anim);
+    } else {
+        if (-1 == ece391_shm_map (SHM_KEY, sizeof (anim_t), (void**)&anim)) {
+	    ece391_bufputs (1, (uint8_t*)"could not map shared memory\n");
+	    return 3;
+	}
+	rval = render (anim);
+    }
+
+    ece391_shm_unmap (SHM_KEY);
+    return rval;
+}
@@ -3,6 +3,19 @@
 #include "ece391support.h"
 #include "ece391syscall.h"
 
+/*
+ * Buffered output: ece391_bufputs and ece391_bufwrite collect output per
+ * file descriptor and hand it to the kernel in one write when the buffer
+ * fills up or it is flushed. Flush before reading input that answers a
+ * prompt; _start flushes everything when main returns.
+ */
+#define OUT_FDS     8
+#define OUT_BUFSIZE 4096
+
+/* one extra byte for the NUL the terminal driver stops at */
+static uint8_t out_buf[OUT_FDS][OUT_BUFSIZE + 1];
+static int32_t out_len[OUT_FDS];
+
 uint32_t ece391_strlen(const uint8_t* s)
 {
     uint32_t len;
@@ -21,6 +34,190 @@ void ece391_fdputs(int32_t fd, const uint8_t* s)
     (void)ece391_write (fd, s, ece391_strlen(s));
 }
 
+int32_t ece391_flush(int32_t fd)
+{
+    int32_t len;
+
+    if (fd < 0 || fd >= OUT_FDS || 0 == out_len[fd])
+        return 0;
+    len = out_len[fd];
+    out_len[fd] = 0;
+    out_buf[fd][len] = '\0';
+    return ece391_write (fd, out_buf[fd], len);
+}
+
+void ece391_flushall(void)
+{
+    int32_t fd;
+
+    for (fd = 0; fd < OUT_FDS; fd++)
+        (void)ece391_flush (fd);
+}
+
+int32_t ece391_bufwrite(int32_t fd, const void* buf, int32_t nbytes)
+{
+    const uint8_t* src = buf;
+    int32_t i;
+
+    if (fd < 0 || fd >= OUT_FDS)
+        return ece391_write (fd, buf, nbytes);
+    for (i = 0; i < nbytes; i++) {
+        if (OUT_BUFSIZE == out_len[fd] && -1 == ece391_flush (fd))
+            return -1;
+        out_buf[fd][out_len[fd]++] = src[i];
+    }
+    return nbytes;
+}
+
+void ece391_bufputs(int32_t fd, const uint8_t* s)
+{
+    (void)ece391_bufwrite (fd, s, ece391_strlen(s));
+}
+
+int32_t ece391_ring_queue(io_ring_t* ring, int32_t opcode, int32_t fd,
+                          void* buf, int32_t nbytes, uint32_t user_data)
+{
+    ring_sqe_t* sqe;
+
+    if (RING_ENTRIES == ring->sq_tail - ring->sq_head)
+        return -1;
+    sqe = &ring->sq[ring->sq_tail % RING_ENTRIES];
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->buf = (uint32_t)buf;
+    sqe->nbytes = nbytes;
+    sqe->user_data = user_data;
+    ring->sq_tail++;
+    return 0;
+}
+
+int32_t ece391_ring_reap(io_ring_t* ring, ring_cqe_t* cqe)
+{
+    if (ring->cq_head == ring->cq_tail)
+        return -1;
+    *cqe = ring->cq[ring->cq_head % RING_ENTRIES];
+    ring->cq_head++;
+    return 0;
+}
+
+/*
+ * The heap: ece391_malloc keeps a free list per size class (16 B up to
+ * 2 KB) and carves new blocks out of an arena that it grows with
+ * ece391_brk ARENA_GROW bytes at a time, so most calls never enter the
+ * kernel. Bigger blocks are cut from the arena to size and reused first
+ * fit once freed, splitting off whatever the request does not need while
+ * that is still a big block. Every block starts with a header holding its
+ * size.
+ */
+#define HEAP_CLASSES   8
+#define HEAP_MIN_BLOCK 16
+#define HEAP_MAX_BLOCK (HEAP_MIN_BLOCK << (HEAP_CLASSES - 1))
+#define HEAP_HDR       8       /* keeps the blocks 8 byte aligned */
+#define HEAP_ALIGN(n)  (((n) + 7) & ~7)
+#define ARENA_GROW     0x10000
+
+typedef struct heap_block {
+    uint32_t size;                /* usable bytes after the header */
+    uint32_t unused;
+    struct heap_block* next;      /* free list link, in the user's bytes */
+} heap_block_t;
+
+static heap_block_t* heap_free[HEAP_CLASSES];
+static heap_block_t* heap_large;
+static uint8_t* arena_next;
+static uint8_t* arena_end;
+
+static void* arena_take(uint32_t n)
+{
+    int32_t end;
+    uint32_t grow;
+    uint8_t* p;
+
+    if (0 == arena_next) {
+        if (-1 == (end = ece391_brk (0)))
+            return 0;
+        arena_next = arena_end = (uint8_t*)end;
+    }
+    if ((uint32_t)(arena_end - arena_next) < n) {
+        grow = n - (arena_end - arena_next);
+        grow = (grow + ARENA_GROW - 1) & ~(ARENA_GROW - 1);
+        if (-1 == (end = ece391_brk (arena_end + grow)))
+            return 0;
+        arena_end = (uint8_t*)end;
+    }
+    p = arena_next;
+    arena_next += n;
+    return p;
+}
+
+static uint32_t heap_class(uint32_t size)
+{
+    uint32_t cls;
+
+    for (cls = 0; (HEAP_MIN_BLOCK << cls) < size; cls++);
+    return cls;
+}
+
+void* ece391_malloc(uint32_t size)
+{
+    heap_block_t** prev;
+    heap_block_t* b;
+    heap_block_t* rest;
+    uint32_t cls;
+
+    if (0 == size)
+        return 0;
+
+    if (size <= HEAP_MAX_BLOCK) {
+        cls = heap_class(size);
+        if (0 != (b = heap_free[cls])) {
+            heap_free[cls] = b->next;
+            return (uint8_t*)b + HEAP_HDR;
+        }
+        size = HEAP_MIN_BLOCK << cls;
+    } else {
+        size = HEAP_ALIGN(size);
+        for (prev = &heap_large; 0 != (b = *prev); prev = &b->next) {
+            if (b->size < size)
+                continue;
+            /* a remainder too small for the big list stays with the block */
+            if (b->size - size > HEAP_HDR + HEAP_MAX_BLOCK) {
+                rest = (heap_block_t*)((uint8_t*)b + HEAP_HDR + size);
+                rest->size = b->size - size - HEAP_HDR;
+                rest->next = b->next;
+                b->size = size;
+                *prev = rest;
+            } else {
+                *prev = b->next;
+            }
+            return (uint8_t*)b + HEAP_HDR;
+        }
+    }
+
+    if (0 == (b = arena_take(HEAP_HDR + size)))
+        return 0;
+    b->size = size;
+    return (uint8_t*)b + HEAP_HDR;
+}
+
+void ece391_free(void* ptr)
+{
+    heap_block_t* b;
+    uint32_t cls;
+
+    if (0 == ptr)
+        return;
+    b = (heap_block_t*)((uint8_t*)ptr - HEAP_HDR);
+    if (b->size <= HEAP_MAX_BLOCK) {
+        cls = heap_class(b->size);
+        b->next = heap_free[cls];
+        heap_free[cls] = b;
+    } else {
+        b->next = heap_large;
+        heap_large = b;
+    }
+}
+
 int32_t ece391_strcmp(const uint8_t* s1, const uint8_t* s2)
 {
     while (*s1 == *s2) {
@@ -1,9 +1,20 @@
 #if !defined(ECE391SUPPORT_H)
 #define ECE391SUPPORT_H
 
+#include "ece391syscall.h"
+
 extern uint32_t ece391_strlen(const uint8_t* s);
 extern void ece391_strcpy(uint8_t* dst, const uint8_t* src);
 extern void ece391_fdputs(int32_t fd, const uint8_t* s);
+extern void ece391_bufputs(int32_t fd, const uint8_t* s);
+extern int32_t ece391_bufwrite(int32_t fd, const void* buf, int32_t nbytes);
+extern int32_t ece391_flush(int32_t fd);
+extern void ece391_flushall(void);
+extern int32_t ece391_ring_queue(io_ring_t* ring, int32_t opcode, int32_t fd,
+                                 void* buf, int32_t nbytes, uint32_t user_data);
+extern int32_t ece391_ring_reap(io_ring_t* ring, ring_cqe_t* cqe);
+extern void* ece391_malloc(uint32_t size);
+extern void ece391_free(void* ptr);
 extern int32_t ece391_strcmp(const uint8_t* s1, const uint8_t* s2);
 extern int32_t ece391_strncmp(const uint8_t* s1, const uint8_t* s2, uint32_t n);
 extern uint8_t *ece391_itoa(uint32_t value, uint8_t* buf, int32_t radix);
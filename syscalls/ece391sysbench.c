@@ -0,0 +1,51 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NUM_CALLS 10000
+#define BUFSIZE 16
+
+/* Read the low half of the time stamp counter */
+static uint32_t rdtsc (void)
+{
+    uint32_t lo, hi;
+
+    asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+    return lo;
+}
+
+/* Time NUM_CALLS null system calls (closing fd -1 fails right away) and
+   print the average round trip in cycles */
+static void time_calls (const char* name)
+{
+    uint8_t buf[BUFSIZE];
+    uint32_t start, end;
+    int32_t i;
+
+    start = rdtsc ();
+    for (i = 0; i < NUM_CALLS; i++)
+        (void)ece391_close (-1);
+    end = rdtsc ();
+
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_fdputs (1, ece391_itoa ((end - start) / NUM_CALLS, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" cycles per call\n");
+}
+
+int main ()
+{
+    int32_t fast = ece391_use_sysenter;
+
+    ece391_use_sysenter = 0;
+    time_calls ("int 0x80: ");
+
+    if (!fast) {
+        ece391_fdputs (1, (uint8_t*)"sysenter: not supported by this cpu\n");
+        return 0;
+    }
+    ece391_use_sysenter = 1;
+    time_calls ("sysenter: ");
+
+    return 0;
+}
@@ -3,6 +3,41 @@
 
 #include <stdint.h>
 
+/*
+ * The submission/completion ring shared with the kernel. Operations are
+ * queued at sq[sq_tail % RING_ENTRIES] and handed over by moving sq_tail,
+ * ece391_ring_enter runs up to to_submit of them and posts their results
+ * at cq_tail. The indexes run freely.
+ */
+#define RING_ENTRIES 128
+
+#define RING_OP_READ  0
+#define RING_OP_WRITE 1
+#define RING_OP_OPEN  2   /* buf holds the file name */
+#define RING_OP_CLOSE 3
+
+typedef struct ring_sqe {
+	int32_t opcode;
+	int32_t fd;
+	uint32_t buf;
+	int32_t nbytes;
+	uint32_t user_data;
+} ring_sqe_t;
+
+typedef struct ring_cqe {
+	uint32_t user_data;
+	int32_t result;
+} ring_cqe_t;
+
+typedef struct io_ring {
+	volatile uint32_t sq_head;
+	volatile uint32_t sq_tail;
+	volatile uint32_t cq_head;
+	volatile uint32_t cq_tail;
+	ring_sqe_t sq[RING_ENTRIES];
+	ring_cqe_t cq[RING_ENTRIES];
+} io_ring_t;
+
 /* All calls return >= 0 on success or -1 on failure. */
 
 /*  
@@ -21,6 +56,29 @@ extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
+extern int32_t ece391_ring_setup (io_ring_t** ring);
+extern int32_t ece391_ring_enter (int32_t to_submit);
+/* copies a regular file to another descriptor without a user buffer */
+extern int32_t ece391_sendfile (int32_t out_fd, int32_t in_fd, int32_t count);
+/* moves the end of the heap (0 to ask where it is), returns the new end */
+extern int32_t ece391_brk (void* addr);
+/* opens a pipe, fds[0] reads what is written to fds[1] */
+extern int32_t ece391_pipe (int32_t fds[2]);
+/* starts a command without waiting for it, on the given pipe ends (-1 for
+   the terminal), and returns its pid */
+extern int32_t ece391_spawn (const uint8_t* command, int32_t in_fd, int32_t out_fd);
+/* waits for a spawned command and returns what it halted with */
+extern int32_t ece391_wait (int32_t pid);
+/* 1 if fd is the terminal, 0 if it is a pipe or a file */
+extern int32_t ece391_isatty (int32_t fd);
+/* maps the shared memory segment named key (made zeroed with size bytes if
+   nobody has it, size 0 takes it as it is) at the same address in every
+   process that maps it */
+extern int32_t ece391_shm_map (uint32_t key, uint32_t size, void** addr);
+extern int32_t ece391_shm_unmap (uint32_t key);
+
+/* nonzero if the calls above enter with SYSENTER instead of int 0x80 */
+extern int32_t ece391_use_sysenter;
 
 enum signums {
 	DIV_ZERO = 0,
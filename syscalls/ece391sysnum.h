@@ -11,5 +11,15 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_RING_SETUP  11
+#define SYS_RING_ENTER  12
+#define SYS_SENDFILE  13
+#define SYS_BRK  14
+#define SYS_PIPE  15
+#define SYS_SPAWN  16
+#define SYS_WAIT  17
+#define SYS_ISATTY  18
+#define SYS_SHM_MAP  19
+#define SYS_SHM_UNMAP  20
 
 #endif /* ECE391SYSNUM_H */